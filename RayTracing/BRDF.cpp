@@ -0,0 +1,166 @@
+//
+//  BRDF.cpp
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#include "BRDF.h"
+
+#include "ShadingFrame.h"
+
+#include <cmath>
+
+namespace Utils {
+
+    static constexpr float Pi = 3.14159265358979f;
+
+    // Smoothest GGX roughness (alpha) used. Lower values approach a mirror too closely for single precision.
+    static constexpr float MinAlpha = 0.002f;
+
+    // What the material reflects, resolved for one view direction
+    struct Lobes {
+        float alpha;
+        glm::vec3 specularColor;
+        glm::vec3 diffuseColor;
+        float specularProbability;
+    };
+
+    static float Luminance(const glm::vec3& color) {
+        return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+    }
+
+    static glm::vec3 Schlick(const glm::vec3& specularColor, float cosine) {
+        float factor = glm::pow(1.0f - glm::clamp(cosine, 0.0f, 1.0f), 5.0f);
+
+        return specularColor + (glm::vec3(1.0f) - specularColor) * factor;
+    }
+
+    static Lobes MakeLobes(const Material& material, float viewCosine) {
+        Lobes lobes;
+        lobes.alpha = glm::max(material.roughness * material.roughness, MinAlpha);
+        lobes.specularColor = glm::mix(glm::vec3(0.04f), material.albedo, material.metallic);
+        lobes.diffuseColor = material.albedo * (1.0f - material.metallic);
+
+        // Each lobe is sampled in proportion to its reflectance seen from the view direction
+        float specularWeight = Luminance(Schlick(lobes.specularColor, viewCosine));
+        float diffuseWeight = Luminance(lobes.diffuseColor) * (1.0f - specularWeight);
+
+        float totalWeight = specularWeight + diffuseWeight;
+        lobes.specularProbability = totalWeight > 0.0f ? specularWeight / totalWeight : 1.0f;
+
+        return lobes;
+    }
+
+    // GGX normal distribution, for a local half vector
+    static float D(const glm::vec3& half, float alpha) {
+        float alpha2 = alpha * alpha;
+        float denominator = half.z * half.z * (alpha2 - 1.0f) + 1.0f;
+
+        return alpha2 / (Pi * denominator * denominator);
+    }
+
+    // Smith's auxiliary function for GGX, for a local direction above the surface
+    static float Lambda(const glm::vec3& direction, float alpha) {
+        float cosine2 = direction.z * direction.z;
+        float tangent2 = glm::max(1.0f - cosine2, 0.0f) / cosine2;
+
+        return 0.5f * (-1.0f + std::sqrt(1.0f + alpha * alpha * tangent2));
+    }
+
+    // Heitz, "Sampling the GGX Distribution of Visible Normals". Stretches the view to the unit roughness
+    // configuration, samples the projected hemisphere there and unstretches the normal.
+    static glm::vec3 SampleVisibleNormal(const glm::vec3& view, float alpha, float u1, float u2) {
+        glm::vec3 stretchedView = glm::normalize(glm::vec3(alpha * view.x, alpha * view.y, view.z));
+
+        float lengthSquared = stretchedView.x * stretchedView.x + stretchedView.y * stretchedView.y;
+        glm::vec3 t1 = lengthSquared > 0.0f ? glm::vec3(-stretchedView.y, stretchedView.x, 0.0f) / std::sqrt(lengthSquared) : glm::vec3(1.0f, 0.0f, 0.0f);
+        glm::vec3 t2 = glm::cross(stretchedView, t1);
+
+        float radius = std::sqrt(u1);
+        float phi = 2.0f * Pi * u2;
+        float p1 = radius * std::cos(phi);
+        float p2 = radius * std::sin(phi);
+        float s = 0.5f * (1.0f + stretchedView.z);
+        p2 = (1.0f - s) * std::sqrt(glm::max(1.0f - p1 * p1, 0.0f)) + s * p2;
+
+        glm::vec3 normal = t1 * p1 + t2 * p2 + stretchedView * std::sqrt(glm::max(1.0f - p1 * p1 - p2 * p2, 0.0f));
+
+        return glm::normalize(glm::vec3(alpha * normal.x, alpha * normal.y, glm::max(normal.z, 0.0f)));
+    }
+
+    // The BRDF times the cosine, and the sampling density, in the local frame
+    static glm::vec3 EvaluateLocal(const Lobes& lobes, const glm::vec3& view, const glm::vec3& light, float& pdf) {
+        pdf = 0.0f;
+
+        if (view.z <= 0.0f || light.z <= 0.0f) {
+            return glm::vec3(0.0f);
+        }
+
+        glm::vec3 half = glm::normalize(view + light);
+
+        float distribution = D(half, lobes.alpha);
+        float lambdaView = Lambda(view, lobes.alpha);
+        float lambdaLight = Lambda(light, lobes.alpha);
+        glm::vec3 fresnel = Schlick(lobes.specularColor, glm::dot(view, half));
+
+        // Height-correlated Smith masking and shadowing
+        float g2 = 1.0f / (1.0f + lambdaView + lambdaLight);
+        float g1 = 1.0f / (1.0f + lambdaView);
+
+        glm::vec3 specular = fresnel * (distribution * g2 / (4.0f * view.z));
+        glm::vec3 diffuse = (glm::vec3(1.0f) - fresnel) * lobes.diffuseColor * (light.z / Pi);
+
+        // The visible normal density, D * G1 * (view . half) / view.z, through the reflection's Jacobian
+        float specularPdf = distribution * g1 / (4.0f * view.z);
+        float diffusePdf = light.z / Pi;
+
+        pdf = lobes.specularProbability * specularPdf + (1.0f - lobes.specularProbability) * diffusePdf;
+
+        return specular + diffuse;
+    }
+}
+
+glm::vec3 BRDF::Evaluate(const Material& material, const glm::vec3& normal, const glm::vec3& view, const glm::vec3& light, float& pdf) {
+    ShadingFrame frame(normal);
+
+    glm::vec3 localView = frame.ToLocal(view);
+    glm::vec3 localLight = frame.ToLocal(light);
+
+    return Utils::EvaluateLocal(Utils::MakeLobes(material, localView.z), localView, localLight, pdf);
+}
+
+bool BRDF::SampleDirection(const Material& material, const glm::vec3& normal, const glm::vec3& view, const glm::vec3& random, Sample& sample) {
+    ShadingFrame frame(normal);
+
+    glm::vec3 localView = frame.ToLocal(view);
+
+    if (localView.z <= 0.0f) {
+        return false;
+    }
+
+    Utils::Lobes lobes = Utils::MakeLobes(material, localView.z);
+
+    glm::vec3 localLight;
+
+    if (random.x < lobes.specularProbability) {
+        glm::vec3 half = Utils::SampleVisibleNormal(localView, lobes.alpha, random.y, random.z);
+        localLight = half * (2.0f * glm::dot(localView, half)) - localView;
+    } else {
+        float radius = std::sqrt(random.y);
+        float phi = 2.0f * Utils::Pi * random.z;
+
+        localLight = glm::vec3(radius * std::cos(phi), radius * std::sin(phi), std::sqrt(glm::max(1.0f - random.y, 0.0f)));
+    }
+
+    glm::vec3 value = Utils::EvaluateLocal(lobes, localView, localLight, sample.pdf);
+
+    if (sample.pdf <= 0.0f) {
+        return false;
+    }
+
+    sample.direction = frame.ToWorld(localLight);
+    sample.weight = value / sample.pdf;
+
+    return true;
+}
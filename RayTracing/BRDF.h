@@ -0,0 +1,34 @@
+//
+//  BRDF.h
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#pragma once
+
+#include "Scene.h"
+
+#include <glm/glm.hpp>
+
+// The metallic-roughness material model: a GGX microfacet specular lobe with Schlick Fresnel, whose reflectance at
+// normal incidence goes from 4% to the albedo as metallic goes to 1, over a Lambertian diffuse lobe that fades out
+// as metallic goes to 1. Directions point away from the surface: view toward the viewer, light toward the light.
+namespace BRDF {
+
+    struct Sample {
+        glm::vec3 direction;
+        glm::vec3 weight; // f * cos / pdf, the factor the path throughput is multiplied by
+        float pdf;
+    };
+
+    // f(view, light) * cos, the reflected fraction of light arriving from the light direction. pdf receives the
+    // density SampleDirection picks that direction with.
+    glm::vec3 Evaluate(const Material& material, const glm::vec3& normal, const glm::vec3& view, const glm::vec3& light, float& pdf);
+
+    // Picks a lobe with random.x, in proportion to how much each is expected to reflect, then a direction from it
+    // with random.y and random.z: GGX normals visible from the view for the specular lobe, a cosine-weighted
+    // hemisphere for the diffuse one. The weight covers both lobes, so it stays bounded whichever was picked.
+    // Returns false when the direction falls below the surface.
+    bool SampleDirection(const Material& material, const glm::vec3& normal, const glm::vec3& view, const glm::vec3& random, Sample& sample);
+}
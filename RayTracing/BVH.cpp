@@ -0,0 +1,969 @@
+//
+//  BVH.cpp
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#include "BVH.h"
+
+#include "SIMD.h"
+
+#include <Walnut/Timer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+namespace Utils {
+
+    // Relative costs used by the surface area heuristic
+    static constexpr float TraversalCost = 1.0f;
+    static constexpr float IntersectionCost = 1.0f;
+
+    static constexpr int BinCount = 16;
+    static constexpr uint32_t MaxLeafSize = 8;
+    static constexpr uint32_t MaxDepth = 64;
+
+    static inline int CountLeadingZeros(uint32_t value) {
+        return value == 0 ? 32 : __builtin_clz(value);
+    }
+
+    static inline int LowestBit(int value) {
+        return __builtin_ctz(static_cast<uint32_t>(value));
+    }
+
+    // Primitives or nodes handed to one scheduler task by the parallel stages of a build
+    static constexpr uint32_t ChunkSize = 1024;
+
+    // Runs body(index) for every index in [0, count), in contiguous chunks on the scheduler's workers, or serially
+    // without a scheduler
+    template<typename Body>
+    static void ParallelFor(TileScheduler* scheduler, uint32_t count, uint32_t chunkSize, const Body& body) {
+        if (scheduler == nullptr) {
+            for (uint32_t index = 0; index < count; index += 1) {
+                body(index);
+            }
+
+            return;
+        }
+
+        scheduler->ParallelFor(count, chunkSize, [&body](uint32_t first, uint32_t last) {
+            for (uint32_t index = first; index < last; index += 1) {
+                body(index);
+            }
+        });
+    }
+
+    // Reduces map(index) over [0, count) the same way
+    template<typename T, typename Map, typename Reduce>
+    static T ParallelReduce(TileScheduler* scheduler, uint32_t count, T identity, const Map& map, const Reduce& reduce) {
+        if (scheduler == nullptr) {
+            T result = identity;
+
+            for (uint32_t index = 0; index < count; index += 1) {
+                result = reduce(result, map(index));
+            }
+
+            return result;
+        }
+
+        return scheduler->ParallelReduce(count, ChunkSize, identity, map, reduce);
+    }
+
+    // Parallel least-significant-digit radix sort of 30-bit keys, carrying values along. Each pass histograms
+    // blocks of the input in parallel, prefix sums the histograms serially, then scatters every block in parallel,
+    // which keeps each pass stable.
+    static void RadixSort(TileScheduler* scheduler, std::vector<uint32_t>& keys, std::vector<uint32_t>& values) {
+        constexpr uint32_t RadixBits = 8;
+        constexpr uint32_t RadixSize = 1 << RadixBits;
+        constexpr uint32_t KeyBits = 30;
+
+        uint32_t count = static_cast<uint32_t>(keys.size());
+        uint32_t threadCount = scheduler != nullptr ? scheduler->GetWorkerCount() : 1;
+        uint32_t blockCount = std::max(1u, std::min(threadCount * 4, count / 4096));
+        uint32_t blockSize = (count + blockCount - 1) / blockCount;
+
+        std::vector<uint32_t> offsets(blockCount * RadixSize);
+
+        std::vector<uint32_t> scratchKeys(count);
+        std::vector<uint32_t> scratchValues(count);
+
+        for (uint32_t shift = 0; shift < KeyBits; shift += RadixBits) {
+            std::fill(offsets.begin(), offsets.end(), 0);
+
+            ParallelFor(scheduler, blockCount, 1, [&](uint32_t block) {
+                uint32_t* histogram = &offsets[block * RadixSize];
+                uint32_t last = std::min(count, (block + 1) * blockSize);
+
+                for (uint32_t index = block * blockSize; index < last; index += 1) {
+                    histogram[(keys[index] >> shift) & (RadixSize - 1)] += 1;
+                }
+            });
+
+            // Digit-major prefix sum, so block b writes its digit d entries after every earlier block's
+            uint32_t sum = 0;
+
+            for (uint32_t digit = 0; digit < RadixSize; digit += 1) {
+                for (uint32_t block = 0; block < blockCount; block += 1) {
+                    uint32_t& offset = offsets[block * RadixSize + digit];
+                    uint32_t digitCount = offset;
+
+                    offset = sum;
+                    sum += digitCount;
+                }
+            }
+
+            ParallelFor(scheduler, blockCount, 1, [&](uint32_t block) {
+                uint32_t* blockOffsets = &offsets[block * RadixSize];
+                uint32_t last = std::min(count, (block + 1) * blockSize);
+
+                for (uint32_t index = block * blockSize; index < last; index += 1) {
+                    uint32_t destination = blockOffsets[(keys[index] >> shift) & (RadixSize - 1)]++;
+
+                    scratchKeys[destination] = keys[index];
+                    scratchValues[destination] = values[index];
+                }
+            });
+
+            keys.swap(scratchKeys);
+            values.swap(scratchValues);
+        }
+    }
+}
+
+void BVH::Build(const std::vector<Sphere>& spheres, Builder builder, TileScheduler* scheduler) {
+    Walnut::Timer timer;
+
+    Clear();
+
+    if (spheres.empty()) {
+        return;
+    }
+
+    switch (builder) {
+        case Builder::SAH:
+            BuildSAH(spheres);
+            break;
+        case Builder::Linear:
+            BuildLinear(spheres, scheduler);
+            break;
+    }
+
+    weightedAreaSum = Utils::ParallelReduce(scheduler, static_cast<uint32_t>(nodes.size()), 0.0f, [this](uint32_t nodeIndex) {
+        const Node& node = nodes[nodeIndex];
+        return NodeCostWeight(node) * AABB { node.boundsMin, node.boundsMax }.Area();
+    }, std::plus<>());
+
+    buildCost = GetCost();
+
+    statistics.nodeCount = static_cast<uint32_t>(nodes.size());
+    statistics.buildTime = timer.ElapsedMillis();
+}
+
+void BVH::BuildSAH(const std::vector<Sphere>& spheres) {
+    uint32_t count = static_cast<uint32_t>(spheres.size());
+
+    std::vector<AABB> primitiveBounds(count);
+    std::vector<glm::vec3> centroids(count);
+
+    primitiveIndices.resize(count);
+
+    for (uint32_t index = 0; index < count; index += 1) {
+        primitiveBounds[index] = AABB::FromSphere(spheres[index]);
+        centroids[index] = spheres[index].position;
+        primitiveIndices[index] = index;
+    }
+
+    // A binary tree over N primitives never needs more than 2N - 1 nodes
+    nodes.reserve(count * 2 - 1);
+
+    parents.reserve(count * 2 - 1);
+
+    Node& root = nodes.emplace_back();
+    root.leftFirst = 0;
+    root.primitiveCount = count;
+
+    parents.push_back(0);
+
+    UpdateNodeBounds(0, primitiveBounds);
+    Subdivide(0, 0, primitiveBounds, centroids);
+
+    // Map every primitive back to the leaf holding it, so refits can start from the leaf
+    primitiveLeaves.resize(count);
+
+    for (uint32_t nodeIndex = 0; nodeIndex < nodes.size(); nodeIndex += 1) {
+        const Node& node = nodes[nodeIndex];
+
+        for (uint32_t index = 0; index < node.primitiveCount; index += 1) {
+            primitiveLeaves[primitiveIndices[node.leftFirst + index]] = nodeIndex;
+        }
+    }
+}
+
+void BVH::BuildLinear(const std::vector<Sphere>& spheres, TileScheduler* scheduler) {
+    uint32_t count = static_cast<uint32_t>(spheres.size());
+
+    // Morton codes are relative to the bounds of the sphere centers
+    AABB centroidBounds = Utils::ParallelReduce(scheduler, count, AABB(), [&spheres](uint32_t index) {
+        AABB bounds;
+        bounds.Grow(spheres[index].position);
+        return bounds;
+    }, [](AABB lhs, const AABB& rhs) {
+        lhs.Grow(rhs);
+        return lhs;
+    });
+
+    glm::vec3 extent = glm::max(centroidBounds.max - centroidBounds.min, glm::vec3(std::numeric_limits<float>::min()));
+    glm::vec3 scale = 1.0f / extent;
+
+    std::vector<uint32_t> mortonCodes(count);
+    primitiveIndices.resize(count);
+
+    Utils::ParallelFor(scheduler, count, Utils::ChunkSize, [&](uint32_t index) {
+        glm::vec3 normalized = (spheres[index].position - centroidBounds.min) * scale;
+        mortonCodes[index] = Morton::Encode(normalized);
+        primitiveIndices[index] = index;
+    });
+
+    Utils::RadixSort(scheduler, mortonCodes, primitiveIndices);
+
+    nodes.resize(count * 2 - 1);
+    parents.resize(count * 2 - 1);
+    primitiveLeaves.resize(count);
+
+    parents[0] = 0;
+
+    if (count == 1) {
+        Node& root = nodes[0];
+        root.boundsMin = AABB::FromSphere(spheres[0]).min;
+        root.boundsMax = AABB::FromSphere(spheres[0]).max;
+        root.leftFirst = 0;
+        root.primitiveCount = 1;
+
+        primitiveLeaves[0] = 0;
+        statistics.leafCount = 1;
+
+        return;
+    }
+
+    // Emit the hierarchy following Karras, "Maximizing Parallelism in the Construction of BVHs, Octrees, and k-d
+    // Trees". Internal node i covers a key range starting or ending at i, so every internal node finds its range and
+    // split independently. Node i's children are written to the pair of slots 1 + 2i and 2 + 2i, which keeps the
+    // implicit right = left + 1 layout the traversal expects.
+    std::vector<uint32_t> internalSlots(count - 1);
+    std::vector<uint32_t> leafSlots(count);
+
+    internalSlots[0] = 0;
+
+    auto delta = [&mortonCodes, count](int64_t i, int64_t j) -> int {
+        if (j < 0 || j >= count) {
+            return -1;
+        }
+
+        uint32_t lhs = mortonCodes[i];
+        uint32_t rhs = mortonCodes[j];
+
+        // Duplicate codes fall back to comparing the positions in the sorted order
+        if (lhs == rhs) {
+            return 32 + Utils::CountLeadingZeros(static_cast<uint32_t>(i) ^ static_cast<uint32_t>(j));
+        }
+
+        return Utils::CountLeadingZeros(lhs ^ rhs);
+    };
+
+    Utils::ParallelFor(scheduler, count - 1, Utils::ChunkSize, [&](uint32_t index) {
+        int64_t i = index;
+
+        // Direction of the range, and the upper bound of its length
+        int64_t direction = (delta(i, i + 1) - delta(i, i - 1)) >= 0 ? 1 : -1;
+        int deltaMin = delta(i, i - direction);
+
+        int64_t lengthMax = 2;
+
+        while (delta(i, i + lengthMax * direction) > deltaMin) {
+            lengthMax *= 2;
+        }
+
+        // Binary search for the other end of the range
+        int64_t length = 0;
+
+        for (int64_t step = lengthMax / 2; step >= 1; step /= 2) {
+            if (delta(i, i + (length + step) * direction) > deltaMin) {
+                length += step;
+            }
+        }
+
+        int64_t j = i + length * direction;
+        int deltaNode = delta(i, j);
+
+        // Binary search for the split position
+        int64_t split = 0;
+        int64_t step = length;
+
+        do {
+            step = (step + 1) / 2;
+
+            if (delta(i, i + (split + step) * direction) > deltaNode) {
+                split += step;
+            }
+        } while (step > 1);
+
+        int64_t gamma = i + split * direction + std::min<int64_t>(direction, 0);
+
+        uint32_t leftSlot = 1 + 2 * index;
+        uint32_t rightSlot = leftSlot + 1;
+
+        if (std::min(i, j) == gamma) {
+            leafSlots[gamma] = leftSlot;
+        } else {
+            internalSlots[gamma] = leftSlot;
+        }
+
+        if (std::max(i, j) == gamma + 1) {
+            leafSlots[gamma + 1] = rightSlot;
+        } else {
+            internalSlots[gamma + 1] = rightSlot;
+        }
+    });
+
+    // Every slot is known now, so nodes and parent links can be written
+    Utils::ParallelFor(scheduler, count - 1, Utils::ChunkSize, [&](uint32_t index) {
+        uint32_t slot = internalSlots[index];
+
+        nodes[slot].leftFirst = 1 + 2 * index;
+        nodes[slot].primitiveCount = 0;
+
+        parents[1 + 2 * index] = slot;
+        parents[2 + 2 * index] = slot;
+    });
+
+    // Bounds go bottom-up: the second thread to arrive at a node computes it, the first one stops
+    std::vector<std::atomic<uint32_t>> arrivals(nodes.size());
+
+    Utils::ParallelFor(scheduler, count, Utils::ChunkSize, [&](uint32_t index) {
+        uint32_t slot = leafSlots[index];
+        AABB bounds = AABB::FromSphere(spheres[primitiveIndices[index]]);
+
+        Node& leaf = nodes[slot];
+        leaf.boundsMin = bounds.min;
+        leaf.boundsMax = bounds.max;
+        leaf.leftFirst = index;
+        leaf.primitiveCount = 1;
+
+        primitiveLeaves[primitiveIndices[index]] = slot;
+
+        while (slot != 0) {
+            slot = parents[slot];
+
+            if (arrivals[slot].fetch_add(1, std::memory_order_acq_rel) == 0) {
+                break;
+            }
+
+            Node& node = nodes[slot];
+            const Node& left = nodes[node.leftFirst];
+            const Node& right = nodes[node.leftFirst + 1];
+
+            node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+            node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+        }
+    });
+
+    statistics.leafCount = count;
+
+    // Depth is only reported, so a serial walk is fine
+    std::vector<std::pair<uint32_t, uint32_t>> stack;
+    stack.emplace_back(0, 0);
+
+    while (!stack.empty()) {
+        auto [nodeIndex, depth] = stack.back();
+        stack.pop_back();
+
+        statistics.maxDepth = std::max(statistics.maxDepth, depth);
+
+        if (!nodes[nodeIndex].IsLeaf()) {
+            stack.emplace_back(nodes[nodeIndex].leftFirst, depth + 1);
+            stack.emplace_back(nodes[nodeIndex].leftFirst + 1, depth + 1);
+        }
+    }
+}
+
+void BVH::Clear() {
+    nodes.clear();
+    primitiveIndices.clear();
+    parents.clear();
+    primitiveLeaves.clear();
+
+    weightedAreaSum = 0.0f;
+    buildCost = 0.0f;
+
+    statistics = Statistics();
+}
+
+void BVH::Refit(const std::vector<Sphere>& spheres, const std::vector<uint32_t>& dirtyPrimitives) {
+    Walnut::Timer timer;
+
+    for (uint32_t primitive : dirtyPrimitives) {
+        if (primitive >= primitiveLeaves.size()) {
+            continue;
+        }
+
+        uint32_t nodeIndex = primitiveLeaves[primitive];
+
+        // Walk towards the root until a node's bounds stop changing. Everything above it only depends on those bounds.
+        while (RefitNode(nodeIndex, spheres) && nodeIndex != 0) {
+            nodeIndex = parents[nodeIndex];
+        }
+    }
+
+    statistics.refitTime = timer.ElapsedMillis();
+    statistics.refitCount += 1;
+}
+
+void BVH::Refit(const std::vector<Sphere>& spheres) {
+    Walnut::Timer timer;
+
+    if (nodes.empty()) {
+        return;
+    }
+
+    // The builders lay out nodes differently, so the array order says nothing about which nodes are children. A
+    // reversed pre-order walk visits both children before their parent.
+    std::vector<uint32_t> order;
+    order.reserve(nodes.size());
+
+    std::vector<uint32_t> stack;
+    stack.push_back(0);
+
+    while (!stack.empty()) {
+        uint32_t nodeIndex = stack.back();
+        stack.pop_back();
+
+        order.push_back(nodeIndex);
+
+        if (!nodes[nodeIndex].IsLeaf()) {
+            stack.push_back(nodes[nodeIndex].leftFirst);
+            stack.push_back(nodes[nodeIndex].leftFirst + 1);
+        }
+    }
+
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        RefitNode(*it, spheres);
+    }
+
+    statistics.refitTime = timer.ElapsedMillis();
+    statistics.refitCount += 1;
+}
+
+bool BVH::RefitNode(uint32_t nodeIndex, const std::vector<Sphere>& spheres) {
+    Node& node = nodes[nodeIndex];
+
+    AABB bounds;
+
+    if (node.IsLeaf()) {
+        for (uint32_t index = 0; index < node.primitiveCount; index += 1) {
+            bounds.Grow(AABB::FromSphere(spheres[primitiveIndices[node.leftFirst + index]]));
+        }
+    } else {
+        const Node& left = nodes[node.leftFirst];
+        const Node& right = nodes[node.leftFirst + 1];
+
+        bounds.Grow(AABB { left.boundsMin, left.boundsMax });
+        bounds.Grow(AABB { right.boundsMin, right.boundsMax });
+    }
+
+    if (bounds.min == node.boundsMin && bounds.max == node.boundsMax) {
+        return false;
+    }
+
+    float weight = NodeCostWeight(node);
+    weightedAreaSum += weight * (bounds.Area() - AABB { node.boundsMin, node.boundsMax }.Area());
+
+    node.boundsMin = bounds.min;
+    node.boundsMax = bounds.max;
+
+    return true;
+}
+
+float BVH::NodeCostWeight(const Node& node) const {
+    return node.IsLeaf() ? Utils::IntersectionCost * node.primitiveCount : Utils::TraversalCost;
+}
+
+float BVH::GetCost() const {
+    if (nodes.empty()) {
+        return 0.0f;
+    }
+
+    float rootArea = AABB { nodes[0].boundsMin, nodes[0].boundsMax }.Area();
+
+    if (rootArea <= 0.0f) {
+        return 0.0f;
+    }
+
+    return weightedAreaSum / rootArea;
+}
+
+void BVH::Subdivide(uint32_t nodeIndex, uint32_t depth, const std::vector<AABB>& primitiveBounds, const std::vector<glm::vec3>& centroids) {
+    statistics.maxDepth = std::max(statistics.maxDepth, depth);
+
+    Node& node = nodes[nodeIndex];
+
+    int axis = -1;
+    float splitPosition = 0.0f;
+    float splitCost = FindBestSplit(node, primitiveBounds, centroids, axis, splitPosition);
+
+    glm::vec3 extent = node.boundsMax - node.boundsMin;
+    float parentArea = 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    float leafCost = Utils::IntersectionCost * node.primitiveCount;
+
+    bool mustSplit = node.primitiveCount > Utils::MaxLeafSize;
+    bool wantsSplit = axis != -1 && parentArea > 0.0f && (Utils::TraversalCost + splitCost / parentArea) < leafCost;
+
+    if (axis == -1 || depth >= Utils::MaxDepth || (!mustSplit && !wantsSplit)) {
+        statistics.leafCount += 1;
+        return;
+    }
+
+    // Partition the primitive range in place around the split plane
+    auto first = primitiveIndices.begin() + node.leftFirst;
+    auto last = first + node.primitiveCount;
+    auto middle = std::partition(first, last, [&](uint32_t primitive) {
+        return centroids[primitive][axis] < splitPosition;
+    });
+
+    uint32_t leftCount = static_cast<uint32_t>(middle - first);
+
+    if (leftCount == 0 || leftCount == node.primitiveCount) {
+        statistics.leafCount += 1;
+        return;
+    }
+
+    uint32_t leftChild = static_cast<uint32_t>(nodes.size());
+
+    // Children are always allocated as a pair so the right child is implicitly leftChild + 1
+    nodes.emplace_back();
+    nodes.emplace_back();
+
+    parents.push_back(nodeIndex);
+    parents.push_back(nodeIndex);
+
+    // emplace_back may have reallocated, so the node reference is no longer valid
+    Node& parent = nodes[nodeIndex];
+
+    Node& left = nodes[leftChild];
+    left.leftFirst = parent.leftFirst;
+    left.primitiveCount = leftCount;
+
+    Node& right = nodes[leftChild + 1];
+    right.leftFirst = parent.leftFirst + leftCount;
+    right.primitiveCount = parent.primitiveCount - leftCount;
+
+    parent.leftFirst = leftChild;
+    parent.primitiveCount = 0;
+
+    UpdateNodeBounds(leftChild, primitiveBounds);
+    UpdateNodeBounds(leftChild + 1, primitiveBounds);
+
+    Subdivide(leftChild, depth + 1, primitiveBounds, centroids);
+    Subdivide(leftChild + 1, depth + 1, primitiveBounds, centroids);
+}
+
+void BVH::UpdateNodeBounds(uint32_t nodeIndex, const std::vector<AABB>& primitiveBounds) {
+    Node& node = nodes[nodeIndex];
+
+    AABB bounds;
+
+    for (uint32_t index = 0; index < node.primitiveCount; index += 1) {
+        bounds.Grow(primitiveBounds[primitiveIndices[node.leftFirst + index]]);
+    }
+
+    node.boundsMin = bounds.min;
+    node.boundsMax = bounds.max;
+}
+
+float BVH::FindBestSplit(const Node& node, const std::vector<AABB>& primitiveBounds, const std::vector<glm::vec3>& centroids, int& axis, float& splitPosition) const {
+    struct Bin {
+        AABB bounds;
+        uint32_t count = 0;
+    };
+
+    float bestCost = std::numeric_limits<float>::max();
+
+    // Bin over the centroid bounds rather than the node bounds, so large spheres don't squash every bin together
+    AABB centroidBounds;
+
+    for (uint32_t index = 0; index < node.primitiveCount; index += 1) {
+        centroidBounds.Grow(centroids[primitiveIndices[node.leftFirst + index]]);
+    }
+
+    for (int candidateAxis = 0; candidateAxis < 3; candidateAxis += 1) {
+        float boundsMin = centroidBounds.min[candidateAxis];
+        float boundsMax = centroidBounds.max[candidateAxis];
+
+        if (boundsMin == boundsMax) {
+            continue;
+        }
+
+        Bin bins[Utils::BinCount];
+        float scale = static_cast<float>(Utils::BinCount) / (boundsMax - boundsMin);
+
+        for (uint32_t index = 0; index < node.primitiveCount; index += 1) {
+            uint32_t primitive = primitiveIndices[node.leftFirst + index];
+            int binIndex = std::min(Utils::BinCount - 1, static_cast<int>((centroids[primitive][candidateAxis] - boundsMin) * scale));
+
+            bins[binIndex].count += 1;
+            bins[binIndex].bounds.Grow(primitiveBounds[primitive]);
+        }
+
+        // Sweep from both sides to get the area and count on each side of every bin boundary
+        float leftArea[Utils::BinCount - 1];
+        float rightArea[Utils::BinCount - 1];
+        uint32_t leftCount[Utils::BinCount - 1];
+        uint32_t rightCount[Utils::BinCount - 1];
+
+        AABB leftBounds;
+        AABB rightBounds;
+        uint32_t leftSum = 0;
+        uint32_t rightSum = 0;
+
+        for (int index = 0; index < Utils::BinCount - 1; index += 1) {
+            leftSum += bins[index].count;
+            leftCount[index] = leftSum;
+            leftBounds.Grow(bins[index].bounds);
+            leftArea[index] = leftBounds.Area();
+
+            rightSum += bins[Utils::BinCount - 1 - index].count;
+            rightCount[Utils::BinCount - 2 - index] = rightSum;
+            rightBounds.Grow(bins[Utils::BinCount - 1 - index].bounds);
+            rightArea[Utils::BinCount - 2 - index] = rightBounds.Area();
+        }
+
+        float binWidth = (boundsMax - boundsMin) / static_cast<float>(Utils::BinCount);
+
+        for (int index = 0; index < Utils::BinCount - 1; index += 1) {
+            if (leftCount[index] == 0 || rightCount[index] == 0) {
+                continue;
+            }
+
+            float cost = Utils::IntersectionCost * (leftCount[index] * leftArea[index] + rightCount[index] * rightArea[index]);
+
+            if (cost < bestCost) {
+                axis = candidateAxis;
+                splitPosition = boundsMin + binWidth * static_cast<float>(index + 1);
+                bestCost = cost;
+            }
+        }
+    }
+
+    return bestCost;
+}
+
+bool BVH::Intersect(const Ray& ray, const SphereSoA& spheres, float& hitDistance, int& objectIndex, uint32_t& nodesVisited) const {
+    if (nodes.empty()) {
+        return false;
+    }
+
+    glm::vec3 inverseDirection = 1.0f / ray.direction;
+
+    uint32_t stack[Utils::MaxDepth * 2];
+    uint32_t stackSize = 0;
+
+    uint32_t nodeIndex = 0;
+    bool hit = false;
+
+    nodesVisited += 1;
+
+    if (Intersection::RayAABB(ray.origin, inverseDirection, nodes[0].boundsMin, nodes[0].boundsMax, hitDistance) == std::numeric_limits<float>::infinity()) {
+        return false;
+    }
+
+    while (true) {
+        const Node& node = nodes[nodeIndex];
+
+        if (node.IsLeaf()) {
+            hit |= spheres.Intersect(ray, node.leftFirst, node.primitiveCount, hitDistance, objectIndex);
+
+            if (stackSize == 0) {
+                break;
+            }
+
+            nodeIndex = stack[--stackSize];
+            continue;
+        }
+
+        // Visit the nearer child first so the farther one can be culled by the updated hit distance
+        uint32_t nearChild = node.leftFirst;
+        uint32_t farChild = node.leftFirst + 1;
+
+        const Node& left = nodes[nearChild];
+        const Node& right = nodes[farChild];
+
+        float nearDistance = Intersection::RayAABB(ray.origin, inverseDirection, left.boundsMin, left.boundsMax, hitDistance);
+        float farDistance = Intersection::RayAABB(ray.origin, inverseDirection, right.boundsMin, right.boundsMax, hitDistance);
+
+        nodesVisited += 2;
+
+        if (nearDistance > farDistance) {
+            std::swap(nearDistance, farDistance);
+            std::swap(nearChild, farChild);
+        }
+
+        if (nearDistance == std::numeric_limits<float>::infinity()) {
+            if (stackSize == 0) {
+                break;
+            }
+
+            nodeIndex = stack[--stackSize];
+            continue;
+        }
+
+        nodeIndex = nearChild;
+
+        if (farDistance != std::numeric_limits<float>::infinity()) {
+            stack[stackSize++] = farChild;
+        }
+    }
+
+    return hit;
+}
+
+bool BVH::Occluded(const Ray& ray, const SphereSoA& spheres, float maxDistance, uint32_t& nodesVisited) const {
+    if (nodes.empty()) {
+        return false;
+    }
+
+    glm::vec3 inverseDirection = 1.0f / ray.direction;
+
+    uint32_t stack[Utils::MaxDepth * 2];
+    uint32_t stackSize = 0;
+
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const Node& node = nodes[stack[--stackSize]];
+        nodesVisited += 1;
+
+        if (Intersection::RayAABB(ray.origin, inverseDirection, node.boundsMin, node.boundsMax, maxDistance) == std::numeric_limits<float>::infinity()) {
+            continue;
+        }
+
+        if (node.IsLeaf()) {
+            if (spheres.Occluded(ray, node.leftFirst, node.primitiveCount, maxDistance)) {
+                return true;
+            }
+
+            continue;
+        }
+
+        stack[stackSize++] = node.leftFirst + 1;
+        stack[stackSize++] = node.leftFirst;
+    }
+
+    return false;
+}
+
+void BVH::IntersectPacket(const RayPacket& packet, const SphereSoA& spheres, float* hitDistances, int* objectIndices, uint32_t& nodesVisited) const {
+    using namespace SIMD;
+
+    if (nodes.empty()) {
+        return;
+    }
+
+    Float4 zero = Float4::Splat(0.0f);
+
+    // Order children by the packet's central direction, since the packet has no single ray to measure with
+    glm::vec3 centralDirection = packet.GetRay(RayPacket::Size / 2).direction;
+
+    struct StackEntry {
+        uint32_t nodeIndex;
+        int firstRay;
+    };
+
+    StackEntry stack[Utils::MaxDepth * 2];
+    uint32_t stackSize = 0;
+
+    stack[stackSize++] = { 0, 0 };
+
+    // Farthest current hit over the packet, which bounds the interval test. Only changes at leaves.
+    float farthestHit = std::numeric_limits<float>::max();
+
+    while (stackSize > 0) {
+        StackEntry entry = stack[--stackSize];
+        const Node& node = nodes[entry.nodeIndex];
+
+        nodesVisited += 1;
+
+        Float4 minX = Float4::Splat(node.boundsMin.x - packet.origin.x);
+        Float4 minY = Float4::Splat(node.boundsMin.y - packet.origin.y);
+        Float4 minZ = Float4::Splat(node.boundsMin.z - packet.origin.z);
+        Float4 maxX = Float4::Splat(node.boundsMax.x - packet.origin.x);
+        Float4 maxY = Float4::Splat(node.boundsMax.y - packet.origin.y);
+        Float4 maxZ = Float4::Splat(node.boundsMax.z - packet.origin.z);
+
+        // Slab test for the group of 4 rays starting at group, ignoring rays before firstRay
+        auto testGroup = [&](int group, int firstRay) {
+            Float4 inverseX = Float4::Load(&packet.inverseX[group]);
+            Float4 inverseY = Float4::Load(&packet.inverseY[group]);
+            Float4 inverseZ = Float4::Load(&packet.inverseZ[group]);
+
+            Float4 t0X = minX * inverseX;
+            Float4 t0Y = minY * inverseY;
+            Float4 t0Z = minZ * inverseZ;
+            Float4 t1X = maxX * inverseX;
+            Float4 t1Y = maxY * inverseY;
+            Float4 t1Z = maxZ * inverseZ;
+
+            Float4 tNear = Max(Max(Min(t0X, t1X), Min(t0Y, t1Y)), Max(Min(t0Z, t1Z), zero));
+            Float4 tFar = Min(Min(Max(t0X, t1X), Max(t0Y, t1Y)), Min(Max(t0Z, t1Z), Float4::Load(&hitDistances[group])));
+
+            int hitMask = MoveMask(LessEqual(tNear, tFar));
+
+            return group < firstRay ? hitMask & (0xF << (firstRay - group)) & 0xF : hitMask;
+        };
+
+        // The ray that entered the parent usually enters the child too, so try its group before anything else
+        int firstGroup = entry.firstRay & ~3;
+        int hitMask = testGroup(firstGroup, entry.firstRay);
+        int firstRay = -1;
+
+        if (hitMask != 0) {
+            firstRay = firstGroup + Utils::LowestBit(hitMask);
+        } else if (!packet.signsMatch || Intersection::PacketAABB(packet, node.boundsMin, node.boundsMax, farthestHit)) {
+            for (int group = firstGroup + 4; group < RayPacket::Size; group += 4) {
+                hitMask = testGroup(group, 0);
+
+                if (hitMask != 0) {
+                    firstRay = group + Utils::LowestBit(hitMask);
+                    break;
+                }
+            }
+        }
+
+        if (firstRay == -1) {
+            continue;
+        }
+
+        if (node.IsLeaf()) {
+            spheres.IntersectPacket(packet, firstRay, node.leftFirst, node.primitiveCount, hitDistances, objectIndices);
+
+            farthestHit = hitDistances[0];
+
+            for (int index = 1; index < RayPacket::Size; index++) {
+                farthestHit = glm::max(farthestHit, hitDistances[index]);
+            }
+
+            continue;
+        }
+
+        uint32_t nearChild = node.leftFirst;
+        uint32_t farChild = node.leftFirst + 1;
+
+        const Node& left = nodes[nearChild];
+        const Node& right = nodes[farChild];
+
+        if (glm::dot(left.boundsMin + left.boundsMax - right.boundsMin - right.boundsMax, centralDirection) > 0.0f) {
+            std::swap(nearChild, farChild);
+        }
+
+        stack[stackSize++] = { farChild, firstRay };
+        stack[stackSize++] = { nearChild, firstRay };
+    }
+}
+
+namespace Morton {
+
+    // Spreads the lower 10 bits of value so there are two zero bits between each of them
+    static inline uint32_t ExpandBits(uint32_t value) {
+        value = (value * 0x00010001u) & 0xFF0000FFu;
+        value = (value * 0x00000101u) & 0x0F00F00Fu;
+        value = (value * 0x00000011u) & 0xC30C30C3u;
+        value = (value * 0x00000005u) & 0x49249249u;
+
+        return value;
+    }
+
+    uint32_t Encode(const glm::vec3& point) {
+        glm::vec3 scaled = glm::clamp(point * 1024.0f, glm::vec3(0.0f), glm::vec3(1023.0f));
+
+        uint32_t x = ExpandBits(static_cast<uint32_t>(scaled.x));
+        uint32_t y = ExpandBits(static_cast<uint32_t>(scaled.y));
+        uint32_t z = ExpandBits(static_cast<uint32_t>(scaled.z));
+
+        return (x << 2) | (y << 1) | z;
+    }
+}
+
+namespace Intersection {
+
+    float RaySphere(const Ray& ray, const Sphere& sphere) {
+        // (bx^2 + by^2 + bz^2)t^2 + (2(axbx + ayby + azbz))t + (ax^2 + ay^2 + az^2 - r^2) = 0]
+        // where
+        // a = ray origin
+        // b = ray direction
+        // r = radius
+        // t = hit distance
+
+        // NOTE: a, b, & c are the quadratic variables, not the ones mentioned above. These are the coefficients above
+
+        glm::vec3 origin = ray.origin - sphere.position;
+
+        // float a = rayDirection.x * rayDirection.x + rayDirection.y * rayDirection.y + rayDirection.z * rayDirection.z;
+        float a = glm::dot(ray.direction, ray.direction);
+
+        // float b = 2.0f * (rayOrigin.x * rayDirection.x + rayOrigin.y * rayDirection.y + rayOrigin.z * rayDirection.z);
+        float b = 2.0f * glm::dot(origin, ray.direction);
+
+        // float c = rayOrigin.x * rayOrigin.x + rayOrigin.y * rayOrigin.y * rayOrigin.z * rayOrigin.z - radius * radius;
+        float c = glm::dot(origin, origin) - sphere.radius * sphere.radius;
+
+        // Quadratic formula discriminant
+        // b^2 - 4ac
+        float discriminant = b * b - 4.0f * a * c;
+
+        // No hit
+        if (discriminant < 0.0f) {
+            return -1.0f;
+        }
+
+        // Full quadratic equation
+        // (-b +- sqrt(discriminant)) / (2.0f * a)
+        // float t0 = (-b + glm::sqrt(discriminant)) / (2.0f * a);
+        // float t1 = (-b - glm::sqrt(discriminant)) / (2.0f * a);
+        return (-b - glm::sqrt(discriminant)) / (2.0f * a);
+    }
+
+    float RayAABB(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float maxDistance) {
+        glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+        glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+
+        glm::vec3 tNear = glm::min(t0, t1);
+        glm::vec3 tFar = glm::max(t0, t1);
+
+        float entry = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f));
+        float exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, maxDistance));
+
+        if (entry > exit) {
+            return std::numeric_limits<float>::infinity();
+        }
+
+        return entry;
+    }
+
+    bool PacketAABB(const RayPacket& packet, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float maxDistance) {
+        float entry = 0.0f;
+        float exit = maxDistance;
+
+        for (int axis = 0; axis < 3; axis++) {
+            bool positive = packet.inverseMin[axis] >= 0.0f;
+
+            float nearPlane = (positive ? boundsMin[axis] : boundsMax[axis]) - packet.origin[axis];
+            float farPlane = (positive ? boundsMax[axis] : boundsMin[axis]) - packet.origin[axis];
+
+            // Bound each ray's slab distances by the extremes over the packet's range of inverse directions
+            entry = glm::max(entry, glm::min(nearPlane * packet.inverseMin[axis], nearPlane * packet.inverseMax[axis]));
+            exit = glm::min(exit, glm::max(farPlane * packet.inverseMin[axis], farPlane * packet.inverseMax[axis]));
+        }
+
+        return entry <= exit;
+    }
+}
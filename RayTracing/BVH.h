@@ -0,0 +1,171 @@
+//
+//  BVH.h
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Ray.h"
+#include "Scene.h"
+#include "SphereSoA.h"
+#include "TileScheduler.h"
+
+#include <limits>
+#include <vector>
+
+struct AABB {
+    glm::vec3 min { std::numeric_limits<float>::max() };
+    glm::vec3 max { -std::numeric_limits<float>::max() };
+
+    void Grow(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void Grow(const AABB& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    float Area() const {
+        glm::vec3 extent = max - min;
+
+        if (extent.x < 0.0f) {
+            return 0.0f;
+        }
+
+        return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+
+    static AABB FromSphere(const Sphere& sphere) {
+        float radius = glm::abs(sphere.radius);
+
+        AABB bounds;
+        bounds.min = sphere.position - glm::vec3(radius);
+        bounds.max = sphere.position + glm::vec3(radius);
+
+        return bounds;
+    }
+};
+
+class BVH {
+
+public:
+
+    struct Node {
+        glm::vec3 boundsMin;
+        uint32_t leftFirst; // Left child for interior nodes (right is leftFirst + 1), first primitive for leaves
+        glm::vec3 boundsMax;
+        uint32_t primitiveCount; // 0 for interior nodes
+
+        bool IsLeaf() const { return primitiveCount > 0; }
+    };
+
+    struct Statistics {
+        float buildTime = 0.0f;
+        float refitTime = 0.0f;
+        uint32_t nodeCount = 0;
+        uint32_t leafCount = 0;
+        uint32_t maxDepth = 0;
+        uint32_t refitCount = 0;
+    };
+
+    enum class Builder {
+        SAH,   // Binned surface area heuristic. Best trace performance, single threaded build
+        Linear // Morton code LBVH. Built in parallel, for very large scenes where build time matters most
+    };
+
+public:
+
+    BVH() = default;
+
+    // Builds the tree over the spheres. The linear builder spreads its work over the scheduler's workers, or runs
+    // serially on the calling thread without one.
+    void Build(const std::vector<Sphere>& spheres, Builder builder = Builder::SAH, TileScheduler* scheduler = nullptr);
+    void Clear();
+
+    // Updates node bounds bottom-up for the given primitives only, keeping the topology from the last build
+    void Refit(const std::vector<Sphere>& spheres, const std::vector<uint32_t>& dirtyPrimitives);
+
+    // Updates the bounds of every node, keeping the topology from the last build
+    void Refit(const std::vector<Sphere>& spheres);
+
+    // SAH cost of the current tree relative to the cost right after it was built. Refitting moving spheres grows
+    // this above 1.0, which is the signal that a rebuild would pay for itself.
+    float GetQualityRatio() const { return buildCost > 0.0f ? GetCost() / buildCost : 1.0f; }
+
+    // Finds the closest sphere hit along the ray. hitDistance is the current closest distance on input and is only
+    // updated when something closer is found. nodesVisited is incremented for every node whose bounds were tested.
+    // The spheres must be stored in this tree's primitive order, so each leaf is a contiguous range.
+    bool Intersect(const Ray& ray, const SphereSoA& spheres, float& hitDistance, int& objectIndex, uint32_t& nodesVisited) const;
+
+    // Any-hit query for shadow rays: whether anything is hit closer than maxDistance. Returns at the first hit found,
+    // and since any hit will do, children are visited in tree order without sorting them by distance.
+    bool Occluded(const Ray& ray, const SphereSoA& spheres, float maxDistance, uint32_t& nodesVisited) const;
+
+    // Traverses the tree once for a whole packet, with hitDistances and objectIndices holding one entry per ray. Each
+    // node is entered at the first ray that hits it, so rays that already missed are skipped in the subtree, and a
+    // node no ray can reach is culled with one interval test. nodesVisited counts nodes per packet, not per ray.
+    void IntersectPacket(const RayPacket& packet, const SphereSoA& spheres, float* hitDistances, int* objectIndices, uint32_t& nodesVisited) const;
+
+    bool IsEmpty() const { return nodes.empty(); }
+    size_t GetPrimitiveCount() const { return primitiveIndices.size(); }
+
+    const std::vector<Node>& GetNodes() const { return nodes; }
+    const std::vector<uint32_t>& GetPrimitiveIndices() const { return primitiveIndices; }
+
+    const Statistics& GetStatistics() const { return statistics; }
+
+private:
+
+    void BuildSAH(const std::vector<Sphere>& spheres);
+    void BuildLinear(const std::vector<Sphere>& spheres, TileScheduler* scheduler);
+
+    void Subdivide(uint32_t nodeIndex, uint32_t depth, const std::vector<AABB>& primitiveBounds, const std::vector<glm::vec3>& centroids);
+    void UpdateNodeBounds(uint32_t nodeIndex, const std::vector<AABB>& primitiveBounds);
+
+    float FindBestSplit(const Node& node, const std::vector<AABB>& primitiveBounds, const std::vector<glm::vec3>& centroids, int& axis, float& splitPosition) const;
+
+    bool RefitNode(uint32_t nodeIndex, const std::vector<Sphere>& spheres);
+
+    float NodeCostWeight(const Node& node) const;
+    float GetCost() const;
+
+private:
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> primitiveIndices;
+
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> primitiveLeaves;
+
+    // Sum of area * cost weight over all nodes. Kept up to date incrementally by Refit, and divided by the root area
+    // to get the SAH cost.
+    float weightedAreaSum = 0.0f;
+    float buildCost = 0.0f;
+
+    Statistics statistics;
+};
+
+namespace Morton {
+
+    // 30-bit Morton code for a point inside the unit cube. Points outside are clamped to it.
+    uint32_t Encode(const glm::vec3& point);
+}
+
+namespace Intersection {
+
+    // Returns the distance to the nearest intersection in front of the ray origin, or a negative value for a miss
+    float RaySphere(const Ray& ray, const Sphere& sphere);
+
+    // Slab test. Returns the entry distance, or infinity when the box is missed or farther than maxDistance
+    float RayAABB(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float maxDistance);
+
+    // Conservative test of a box against every ray of a packet whose direction signs match. Returns false only when
+    // no ray in the packet can hit the box closer than maxDistance.
+    bool PacketAABB(const RayPacket& packet, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float maxDistance);
+}
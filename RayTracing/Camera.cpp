@@ -7,13 +7,10 @@
 
 #include "Camera.h"
 
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/quaternion.hpp>
-#include <glm/gtx/quaternion.hpp>
-
-#include "Walnut/Input/Input.h"
+#include "SIMD.h"
+#include "TileScheduler.h"
 
-using namespace Walnut;
+#include <glm/gtc/matrix_transform.hpp>
 
 Camera::Camera(float verticalFOV, float nearClip, float farClip) :
     verticalFOV(verticalFOV),
@@ -24,67 +21,12 @@ Camera::Camera(float verticalFOV, float nearClip, float farClip) :
     position = glm::vec3(0, 0, 6);
 }
 
-bool Camera::OnUpdate(float ts) {
-    glm::vec2 mousePosition = Input::GetMousePosition();
-    glm::vec2 delta = (mousePosition - lastMousePosition) * 0.002f;
-    lastMousePosition = mousePosition;
-    
-    if (!Input::IsMouseButtonDown(MouseButton::Right)) {
-        Input::SetCursorMode(CursorMode::Normal);
-        return false;
-    }
-    
-    Input::SetCursorMode(CursorMode::Locked);
-    
-    bool moved = false;
-    
-    constexpr glm::vec3 upDirection(0.0f, 1.0f, 0.0f);
-    glm::vec3 rightDirection = glm::cross(forwardDirection, upDirection);
-    
-    float speed = 5.0f;
-    
-    // Movement
-    if (Input::IsKeyDown(KeyCode::W)) {
-        position += forwardDirection * speed * ts;
-        moved = true;
-    } else if (Input::IsKeyDown(KeyCode::S)) {
-        position -= forwardDirection * speed * ts;
-        moved = true;
-    }
-    
-    if (Input::IsKeyDown(KeyCode::A)) {
-        position -= rightDirection * speed * ts;
-        moved = true;
-    } else if (Input::IsKeyDown(KeyCode::D)) {
-        position += rightDirection * speed * ts;
-        moved = true;
-    }
-    
-    if (Input::IsKeyDown(KeyCode::Q)) {
-        position -= upDirection * speed * ts;
-        moved = true;
-    } else if (Input::IsKeyDown(KeyCode::E)) {
-        position += upDirection * speed * ts;
-        moved = true;
-    }
+void Camera::SetView(const glm::vec3& position, const glm::vec3& direction) {
+    this->position = position;
+    forwardDirection = glm::normalize(direction);
     
-    // Rotation
-    if (delta.x != 0.0f || delta.y != 0.0f) {
-        float pitchDelta = delta.y * GetRotationSpeed();
-        float yawDelta = delta.x * GetRotationSpeed();
-        
-        glm::quat q = glm::normalize(glm::cross(glm::angleAxis(-pitchDelta, rightDirection), glm::angleAxis(-yawDelta, glm::vec3(0.0f, 1.0f, 0.0f))));
-        forwardDirection = glm::rotate(q, forwardDirection);
-        
-        moved = true;
-    }
-    
-    if (moved) {
-        RecalculateView();
-        RecalculateRayDirections();
-    }
-    
-    return moved;
+    RecalculateView();
+    RecalculateRayDirections();
 }
 
 void Camera::OnResize(uint32_t width, uint32_t height) {
@@ -113,17 +55,93 @@ void Camera::RecalculateView() {
     inverseView = glm::inverse(view);
 }
 
+void Camera::SetCacheRayDirections(bool cache, TileScheduler* scheduler) {
+    rayDirectionScheduler = scheduler;
+    
+    if (cache == cacheRayDirections) {
+        return;
+    }
+    
+    cacheRayDirections = cache;
+    RecalculateRayDirections();
+}
+
 void Camera::RecalculateRayDirections() {
+    // The projection is a perspective one, so w is the same for every point on the far plane, and the unnormalized
+    // direction is linear in the pixel coordinates. So is the rotation into world space.
+    auto farPoint = [this](float x, float y) {
+        glm::vec4 target = inverseProjection * glm::vec4(x, y, 1, 1);
+        return glm::vec3(inverseView * glm::vec4(glm::vec3(target) / target.w, 0));
+    };
+    
+    rayCorner = farPoint(-1.0f, -1.0f);
+    rayDeltaX = (farPoint(1.0f, -1.0f) - rayCorner) / (float)viewportWidth;
+    rayDeltaY = (farPoint(-1.0f, 1.0f) - rayCorner) / (float)viewportHeight;
+    
+    if (!cacheRayDirections) {
+        rayDirections.clear();
+        rayDirections.shrink_to_fit();
+        
+        return;
+    }
+    
     rayDirections.resize(viewportWidth * viewportHeight);
     
-    for (uint32_t y = 0; y < viewportHeight; y++) {
-        for (uint32_t x = 0; x < viewportWidth; x++) {
-            glm::vec2 coord = { (float)x / (float)viewportWidth, (float)y / (float)viewportHeight };
-            coord = coord * 2.0f - 1.0f; // -1 -> 1
-            
-            glm::vec4 target = inverseProjection * glm::vec4(coord.x, coord.y, 1, 1);
-            glm::vec3 rayDirection = glm::vec3(inverseView * glm::vec4(glm::normalize(glm::vec3(target) / target.w), 0)); // World space
-            rayDirections[x + y * viewportWidth] = rayDirection;
+    if (rayDirectionScheduler == nullptr) {
+        for (uint32_t y = 0; y < viewportHeight; y++) {
+            RecalculateRayDirectionRow(y);
+        }
+        
+        return;
+    }
+    
+    rayDirectionScheduler->Run(viewportHeight, [this](uint32_t y, uint32_t) {
+        RecalculateRayDirectionRow(y);
+    });
+}
+
+void Camera::RecalculateRayDirectionRow(uint32_t y) {
+    using namespace SIMD;
+    
+    // The same sum as GetRayDirection, four pixels at a time
+    glm::vec3* row = &rayDirections[y * viewportWidth];
+    
+    Float4 deltaX[3] = { Float4::Splat(rayDeltaX.x), Float4::Splat(rayDeltaX.y), Float4::Splat(rayDeltaX.z) };
+    Float4 corner[3] = { Float4::Splat(rayCorner.x), Float4::Splat(rayCorner.y), Float4::Splat(rayCorner.z) };
+    Float4 rowOffset[3] = {
+        Float4::Splat(static_cast<float>(y) * rayDeltaY.x),
+        Float4::Splat(static_cast<float>(y) * rayDeltaY.y),
+        Float4::Splat(static_cast<float>(y) * rayDeltaY.z)
+    };
+    
+    Float4 one = Float4::Splat(1.0f);
+    
+    uint32_t x = 0;
+    
+    for (; x + 4 <= viewportWidth; x += 4) {
+        alignas(16) float columns[4] = { static_cast<float>(x), static_cast<float>(x + 1), static_cast<float>(x + 2), static_cast<float>(x + 3) };
+        Float4 column = Float4::Load(columns);
+        
+        Float4 direction[3];
+        
+        for (int axis = 0; axis < 3; axis++) {
+            direction[axis] = (corner[axis] + column * deltaX[axis]) + rowOffset[axis];
+        }
+        
+        Float4 inverseLength = one / Sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+        
+        alignas(16) float components[3][4];
+        
+        for (int axis = 0; axis < 3; axis++) {
+            (direction[axis] * inverseLength).Store(components[axis]);
         }
+        
+        for (int lane = 0; lane < 4; lane++) {
+            row[x + lane] = { components[0][lane], components[1][lane], components[2][lane] };
+        }
+    }
+    
+    for (; x < viewportWidth; x++) {
+        row[x] = glm::normalize(rayCorner + static_cast<float>(x) * rayDeltaX + static_cast<float>(y) * rayDeltaY);
     }
 }
@@ -10,15 +10,21 @@
 #include <glm/glm.hpp>
 #include <vector>
 
+class TileScheduler;
+
 class Camera {
     
 public:
     
     Camera(float verticalFOV, float nearClip, float farClip);
     
+    // Moves the camera from mouse and keyboard input. Lives in CameraInput.cpp, which only the application builds.
     bool OnUpdate(float ts);
     void OnResize(uint32_t width, uint32_t height);
     
+    // Places the camera directly, for front ends without input
+    void SetView(const glm::vec3& position, const glm::vec3& direction);
+    
     const glm::mat4& GetProjection() const { return projection; }
     const glm::mat4& GetInverseProjection() const { return inverseProjection; }
     const glm::mat4& GetView() const { return view; }
@@ -27,7 +33,20 @@ public:
     const glm::vec3& GetPosition() const { return position; }
     const glm::vec3& GetDirection() const { return forwardDirection; }
     
-    const std::vector<glm::vec3>& GetRayDirections() const { return rayDirections; }
+    // World space direction of the primary ray through pixel (x, y). Derived from the frustum corner and the per-pixel
+    // steps across it, unless the per-pixel cache is on.
+    glm::vec3 GetRayDirection(uint32_t x, uint32_t y) const {
+        if (cacheRayDirections) {
+            return rayDirections[x + y * viewportWidth];
+        }
+        
+        return glm::normalize(rayCorner + static_cast<float>(x) * rayDeltaX + static_cast<float>(y) * rayDeltaY);
+    }
+    
+    // The per-pixel direction cache costs 12 bytes per pixel and a rebuild on every move, four pixels at a time and
+    // split by row across the scheduler's workers, or serial without one. Kept for comparison.
+    void SetCacheRayDirections(bool cache, TileScheduler* scheduler = nullptr);
+    bool IsCachingRayDirections() const { return cacheRayDirections; }
     
     float GetRotationSpeed();
     
@@ -36,6 +55,7 @@ private:
     void RecalculateProjection();
     void RecalculateView();
     void RecalculateRayDirections();
+    void RecalculateRayDirectionRow(uint32_t y);
     
 private:
     
@@ -51,7 +71,14 @@ private:
     glm::vec3 position{ 0.0f, 0.0f, 0.0f };
     glm::vec3 forwardDirection{ 0.0f, 0.0f, 0.0f };
     
+    // Unnormalized direction through pixel (0, 0), and the step to the next pixel in x and y, in world space
+    glm::vec3 rayCorner{ 0.0f, 0.0f, -1.0f };
+    glm::vec3 rayDeltaX{ 0.0f, 0.0f, 0.0f };
+    glm::vec3 rayDeltaY{ 0.0f, 0.0f, 0.0f };
+    
+    bool cacheRayDirections = false;
     std::vector<glm::vec3> rayDirections;
+    TileScheduler* rayDirectionScheduler = nullptr;
     
     glm::vec2 lastMousePosition{ 0.0f, 0.0f };
     
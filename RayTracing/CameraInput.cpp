@@ -0,0 +1,78 @@
+//
+//  CameraInput.cpp
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#include "Camera.h"
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include "Walnut/Input/Input.h"
+
+using namespace Walnut;
+
+bool Camera::OnUpdate(float ts) {
+    glm::vec2 mousePosition = Input::GetMousePosition();
+    glm::vec2 delta = (mousePosition - lastMousePosition) * 0.002f;
+    lastMousePosition = mousePosition;
+    
+    if (!Input::IsMouseButtonDown(MouseButton::Right)) {
+        Input::SetCursorMode(CursorMode::Normal);
+        return false;
+    }
+    
+    Input::SetCursorMode(CursorMode::Locked);
+    
+    bool moved = false;
+    
+    constexpr glm::vec3 upDirection(0.0f, 1.0f, 0.0f);
+    glm::vec3 rightDirection = glm::cross(forwardDirection, upDirection);
+    
+    float speed = 5.0f;
+    
+    // Movement
+    if (Input::IsKeyDown(KeyCode::W)) {
+        position += forwardDirection * speed * ts;
+        moved = true;
+    } else if (Input::IsKeyDown(KeyCode::S)) {
+        position -= forwardDirection * speed * ts;
+        moved = true;
+    }
+    
+    if (Input::IsKeyDown(KeyCode::A)) {
+        position -= rightDirection * speed * ts;
+        moved = true;
+    } else if (Input::IsKeyDown(KeyCode::D)) {
+        position += rightDirection * speed * ts;
+        moved = true;
+    }
+    
+    if (Input::IsKeyDown(KeyCode::Q)) {
+        position -= upDirection * speed * ts;
+        moved = true;
+    } else if (Input::IsKeyDown(KeyCode::E)) {
+        position += upDirection * speed * ts;
+        moved = true;
+    }
+    
+    // Rotation
+    if (delta.x != 0.0f || delta.y != 0.0f) {
+        float pitchDelta = delta.y * GetRotationSpeed();
+        float yawDelta = delta.x * GetRotationSpeed();
+        
+        glm::quat q = glm::normalize(glm::cross(glm::angleAxis(-pitchDelta, rightDirection), glm::angleAxis(-yawDelta, glm::vec3(0.0f, 1.0f, 0.0f))));
+        forwardDirection = glm::rotate(q, forwardDirection);
+        
+        moved = true;
+    }
+    
+    if (moved) {
+        RecalculateView();
+        RecalculateRayDirections();
+    }
+    
+    return moved;
+}
@@ -0,0 +1,251 @@
+//
+//  Denoiser.cpp
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#include "Denoiser.h"
+
+#include <atomic>
+#include <cmath>
+#include <utility>
+
+namespace Utils {
+
+    // Edge-stopping strengths from the SVGF paper: the luminance difference allowed in standard deviations, and the
+    // depth difference allowed relative to the depth slope
+    static constexpr float LuminanceSigma = 4.0f;
+    static constexpr float DepthSigma = 1.0f;
+
+    // Below this many samples, the variance of a pixel's own samples is too unreliable, and is estimated from its
+    // neighbours instead
+    static constexpr float MinTemporalSamples = 4.0f;
+
+    // Albedo is clamped before dividing by it, so black surfaces keep their lighting as it is
+    static constexpr float MinAlbedo = 0.01f;
+
+    // The B3 spline, the à-trous kernel in each dimension
+    static constexpr float Kernel[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+    static float Luminance(const glm::vec3& color) {
+        return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+    }
+
+    // The cosine between the normals to the power of 128, by squaring seven times
+    static float NormalWeight(const glm::vec3& normal, const glm::vec3& other) {
+        float weight = glm::max(glm::dot(normal, other), 0.0f);
+
+        for (int square = 0; square < 7; square += 1) {
+            weight *= weight;
+        }
+
+        return weight;
+    }
+}
+
+void Denoiser::Denoise(const Input& input, uint32_t iterations, TileScheduler& scheduler) {
+    Prepare(input, scheduler);
+
+    for (uint32_t iteration = 0; iteration < iterations; iteration += 1) {
+        Filter(input, 1u << iteration, buffers[0], buffers[1], scheduler);
+        std::swap(buffers[0], buffers[1]);
+    }
+
+    scheduler.Run(input.height, [this, &input](uint32_t y, uint32_t) {
+        for (uint32_t x = 0; x < input.width; x += 1) {
+            uint32_t index = x + y * input.width;
+            output[index] = glm::vec3(buffers[0][index]) * demodulation[index];
+        }
+    });
+}
+
+void Denoiser::Prepare(const Input& input, TileScheduler& scheduler) {
+    uint32_t width = input.width;
+    uint32_t height = input.height;
+    size_t pixelCount = static_cast<size_t>(width) * height;
+
+    buffers[0].resize(pixelCount);
+    buffers[1].resize(pixelCount);
+    demodulation.resize(pixelCount);
+    depthGradients.resize(pixelCount);
+    output.resize(pixelCount);
+
+    std::atomic<bool> needsSpatialVariance { false };
+
+    scheduler.Run(height, [&](uint32_t y, uint32_t) {
+        for (uint32_t x = 0; x < width; x += 1) {
+            uint32_t index = x + y * width;
+
+            const glm::vec4& accumulated = input.accumulation[index];
+            float count = glm::max(accumulated.a, 1.0f);
+            glm::vec3 mean = glm::vec3(accumulated) / count;
+
+            glm::vec3 albedo = glm::max(input.albedo[index], glm::vec3(Utils::MinAlbedo));
+            demodulation[index] = albedo;
+
+            // The variance of the mean is the variance of the samples over their count. Dividing the color by the
+            // albedo divides the deviation by it too.
+            float variance = -1.0f;
+
+            if (accumulated.a >= Utils::MinTemporalSamples) {
+                float luminance = Utils::Luminance(mean);
+                float sampleVariance = glm::max(input.luminanceSquares[index] / count - luminance * luminance, 0.0f);
+                float albedoLuminance = glm::max(Utils::Luminance(albedo), Utils::MinAlbedo);
+
+                variance = sampleVariance / count / (albedoLuminance * albedoLuminance);
+            } else {
+                needsSpatialVariance = true;
+            }
+
+            buffers[0][index] = glm::vec4(mean / albedo, variance);
+
+            // The steeper of the two directions, from whichever neighbours are on a surface
+            float depth = input.depths[index];
+            float gradient = 0.0f;
+
+            if (depth > 0.0f) {
+                auto slope = [&](uint32_t neighbour) {
+                    float other = input.depths[neighbour];
+                    return other > 0.0f ? glm::abs(other - depth) : 0.0f;
+                };
+
+                float dx = glm::min(x > 0 ? slope(index - 1) : 0.0f, x + 1 < width ? slope(index + 1) : 0.0f);
+                float dy = glm::min(y > 0 ? slope(index - width) : 0.0f, y + 1 < height ? slope(index + width) : 0.0f);
+
+                gradient = glm::max(dx, dy);
+            }
+
+            depthGradients[index] = gradient;
+        }
+    });
+
+    if (!needsSpatialVariance) {
+        return;
+    }
+
+    // Pixels with too few samples take the spread of luminance over their 3x3 neighbourhood on the same surface
+    scheduler.Run(height, [&](uint32_t y, uint32_t) {
+        for (uint32_t x = 0; x < width; x += 1) {
+            uint32_t index = x + y * width;
+            glm::vec4 pixel = buffers[0][index];
+
+            if (pixel.a >= 0.0f) {
+                buffers[1][index] = pixel;
+                continue;
+            }
+
+            float sum = 0.0f;
+            float squares = 0.0f;
+            float weights = 0.0f;
+
+            for (int dy = -1; dy <= 1; dy += 1) {
+                for (int dx = -1; dx <= 1; dx += 1) {
+                    int neighbourX = static_cast<int>(x) + dx;
+                    int neighbourY = static_cast<int>(y) + dy;
+
+                    if (neighbourX < 0 || neighbourY < 0 || neighbourX >= static_cast<int>(width) || neighbourY >= static_cast<int>(height)) {
+                        continue;
+                    }
+
+                    uint32_t neighbour = static_cast<uint32_t>(neighbourX) + static_cast<uint32_t>(neighbourY) * width;
+
+                    if ((input.depths[index] > 0.0f) != (input.depths[neighbour] > 0.0f)) {
+                        continue;
+                    }
+
+                    float weight = input.depths[index] > 0.0f ? Utils::NormalWeight(input.normals[index], input.normals[neighbour]) : 1.0f;
+                    float luminance = Utils::Luminance(glm::vec3(buffers[0][neighbour]));
+
+                    sum += weight * luminance;
+                    squares += weight * luminance * luminance;
+                    weights += weight;
+                }
+            }
+
+            float mean = sum / weights;
+            float count = glm::max(input.accumulation[index].a, 1.0f);
+
+            buffers[1][index] = glm::vec4(glm::vec3(pixel), glm::max(squares / weights - mean * mean, 0.0f) / count);
+        }
+    });
+
+    std::swap(buffers[0], buffers[1]);
+}
+
+void Denoiser::Filter(const Input& input, uint32_t step, const std::vector<glm::vec4>& source, std::vector<glm::vec4>& destination, TileScheduler& scheduler) {
+    int width = static_cast<int>(input.width);
+    int height = static_cast<int>(input.height);
+
+    scheduler.Run(input.height, [&](uint32_t row, uint32_t) {
+        int y = static_cast<int>(row);
+
+        for (int x = 0; x < width; x += 1) {
+            uint32_t index = static_cast<uint32_t>(x + y * width);
+
+            const glm::vec4& center = source[index];
+            float centerLuminance = Utils::Luminance(glm::vec3(center));
+            float centerDepth = input.depths[index];
+            const glm::vec3& centerNormal = input.normals[index];
+
+            // The luminance weight uses the variance blurred over 3x3, which is steadier than the pixel's own
+            float variance = 0.0f;
+
+            for (int dy = -1; dy <= 1; dy += 1) {
+                for (int dx = -1; dx <= 1; dx += 1) {
+                    int neighbourX = glm::clamp(x + dx, 0, width - 1);
+                    int neighbourY = glm::clamp(y + dy, 0, height - 1);
+                    float weight = (dx == 0 ? 0.5f : 0.25f) * (dy == 0 ? 0.5f : 0.25f);
+
+                    variance += weight * source[static_cast<uint32_t>(neighbourX + neighbourY * width)].a;
+                }
+            }
+
+            float luminanceScale = 1.0f / (Utils::LuminanceSigma * std::sqrt(variance) + 1e-6f);
+
+            float centerWeight = Utils::Kernel[2] * Utils::Kernel[2];
+
+            glm::vec3 colorSum = glm::vec3(center) * centerWeight;
+            float varianceSum = center.a * centerWeight * centerWeight;
+            float weightSum = centerWeight;
+
+            for (int dy = -2; dy <= 2; dy += 1) {
+                for (int dx = -2; dx <= 2; dx += 1) {
+                    int neighbourX = x + dx * static_cast<int>(step);
+                    int neighbourY = y + dy * static_cast<int>(step);
+
+                    if ((dx == 0 && dy == 0) || neighbourX < 0 || neighbourY < 0 || neighbourX >= width || neighbourY >= height) {
+                        continue;
+                    }
+
+                    uint32_t neighbour = static_cast<uint32_t>(neighbourX + neighbourY * width);
+                    float neighbourDepth = input.depths[neighbour];
+
+                    // The sky and surfaces never mix
+                    if ((centerDepth > 0.0f) != (neighbourDepth > 0.0f)) {
+                        continue;
+                    }
+
+                    const glm::vec4& sample = source[neighbour];
+                    float weight = Utils::Kernel[dx + 2] * Utils::Kernel[dy + 2];
+
+                    if (centerDepth > 0.0f) {
+                        float distance = static_cast<float>(step) * std::sqrt(static_cast<float>(dx * dx + dy * dy));
+                        float depthScale = Utils::DepthSigma * depthGradients[index] * distance + 1e-3f * centerDepth;
+
+                        weight *= std::exp(-glm::abs(centerDepth - neighbourDepth) / depthScale);
+                        weight *= Utils::NormalWeight(centerNormal, input.normals[neighbour]);
+                    }
+
+                    weight *= std::exp(-glm::abs(centerLuminance - Utils::Luminance(glm::vec3(sample))) * luminanceScale);
+
+                    colorSum += glm::vec3(sample) * weight;
+                    varianceSum += sample.a * weight * weight;
+                    weightSum += weight;
+                }
+            }
+
+            destination[index] = glm::vec4(colorSum / weightSum, varianceSum / (weightSum * weightSum));
+        }
+    });
+}
@@ -0,0 +1,69 @@
+//
+//  Denoiser.h
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "TileScheduler.h"
+
+#include <cstdint>
+#include <vector>
+
+// Edge-avoiding à-trous wavelet filter (Dammertz et al. 2010) with the variance-guided luminance weight of SVGF
+// (Schied et al. 2017). Each iteration blurs with a 5x5 B3 spline kernel whose taps are spread twice as far apart as
+// the last, so a few iterations cover a wide radius. Taps are weighted down across depth and normal edges of the
+// first hit, and by how far their luminance is from the pixel's, relative to the noise the pixel is expected to
+// have. As samples accumulate the variance falls and the filter fades out, leaving the converged image untouched.
+//
+// Color is divided by the albedo before filtering and multiplied back after, so texture detail is not blurred
+// along with the noise in the lighting.
+class Denoiser {
+
+public:
+
+    struct Input {
+        uint32_t width = 0;
+        uint32_t height = 0;
+
+        const glm::vec4* accumulation = nullptr; // Sums of each pixel's samples, alpha the sample count
+        const float* luminanceSquares = nullptr;   // Sums of each pixel's squared sample luminance
+
+        // First-hit features of each pixel. A depth of 0 marks a pixel whose camera ray hit nothing.
+        const glm::vec3* albedo = nullptr;
+        const glm::vec3* normals = nullptr;
+        const float* depths = nullptr;
+    };
+
+public:
+
+    Denoiser() = default;
+
+    // Filters the mean color of every pixel, one row per task on the scheduler's workers
+    void Denoise(const Input& input, uint32_t iterations, TileScheduler& scheduler);
+
+    // The filtered colors, row-major like the input
+    const std::vector<glm::vec3>& GetOutput() const { return output; }
+
+private:
+
+    void Prepare(const Input& input, TileScheduler& scheduler);
+    void Filter(const Input& input, uint32_t step, const std::vector<glm::vec4>& source, std::vector<glm::vec4>& destination, TileScheduler& scheduler);
+
+private:
+
+    // Demodulated color in rgb and the variance of its luminance in alpha, ping-ponged between iterations
+    std::vector<glm::vec4> buffers[2];
+
+    // What the color was divided by, per pixel
+    std::vector<glm::vec3> demodulation;
+
+    // How fast depth changes across each pixel, so depth is compared relative to the slope of the surface
+    std::vector<float> depthGradients;
+
+    std::vector<glm::vec3> output;
+};
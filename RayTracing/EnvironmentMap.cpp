@@ -0,0 +1,140 @@
+//
+//  EnvironmentMap.cpp
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#include "EnvironmentMap.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Utils {
+
+    static constexpr float Pi = 3.14159265358979f;
+
+    static float Luminance(const glm::vec3& color) {
+        return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+    }
+
+    // Fills count + 1 entries of cdf with the running sums of weights, scaled to end at 1, and returns the total.
+    // Without any weight the buckets are even.
+    static float BuildCdf(const float* weights, uint32_t count, float* cdf) {
+        cdf[0] = 0.0f;
+
+        for (uint32_t index = 0; index < count; index += 1) {
+            cdf[index + 1] = cdf[index] + weights[index];
+        }
+
+        float total = cdf[count];
+
+        for (uint32_t index = 1; index <= count; index += 1) {
+            cdf[index] = total > 0.0f ? cdf[index] / total : static_cast<float>(index) / static_cast<float>(count);
+        }
+
+        cdf[count] = 1.0f;
+
+        return total;
+    }
+}
+
+EnvironmentMap::EnvironmentMap(uint32_t width, uint32_t height, const float* rgba) :
+    width(width),
+    height(height),
+    texels(static_cast<size_t>(width) * height),
+    probabilities(static_cast<size_t>(width) * height),
+    conditionalCdfs(static_cast<size_t>(width + 1) * height),
+    marginalCdf(height + 1)
+{
+    for (size_t index = 0; index < texels.size(); index += 1) {
+        texels[index] = glm::vec3(rgba[index * 4 + 0], rgba[index * 4 + 1], rgba[index * 4 + 2]);
+    }
+
+    // Rows near the poles cover less of the sphere, so their texels are weighted down by the sine of their angle
+    std::vector<float> rowTotals(height);
+
+    for (uint32_t y = 0; y < height; y += 1) {
+        float sinTheta = std::sin(Utils::Pi * (static_cast<float>(y) + 0.5f) / static_cast<float>(height));
+
+        for (uint32_t x = 0; x < width; x += 1) {
+            size_t index = static_cast<size_t>(y) * width + x;
+            probabilities[index] = glm::max(Utils::Luminance(texels[index]), 0.0f) * sinTheta;
+        }
+
+        rowTotals[y] = Utils::BuildCdf(&probabilities[static_cast<size_t>(y) * width], width, &conditionalCdfs[static_cast<size_t>(y) * (width + 1)]);
+    }
+
+    Utils::BuildCdf(rowTotals.data(), height, marginalCdf.data());
+
+    // The probabilities are read back from the tables, so the density matches sampling exactly, even for a black
+    // map whose tables are even
+    for (uint32_t y = 0; y < height; y += 1) {
+        for (uint32_t x = 0; x < width; x += 1) {
+            size_t index = static_cast<size_t>(y) * width + x;
+            size_t cdfIndex = static_cast<size_t>(y) * (width + 1) + x;
+
+            probabilities[index] = (marginalCdf[y + 1] - marginalCdf[y]) * (conditionalCdfs[cdfIndex + 1] - conditionalCdfs[cdfIndex]);
+        }
+    }
+}
+
+LightSample EnvironmentMap::SampleDirection(const glm::vec2& random) const {
+    float rowOffset;
+    uint32_t y = SampleCdf(marginalCdf.data(), height, random.y, rowOffset);
+
+    float columnOffset;
+    uint32_t x = SampleCdf(&conditionalCdfs[static_cast<size_t>(y) * (width + 1)], width, random.x, columnOffset);
+
+    float u = (static_cast<float>(x) + columnOffset) / static_cast<float>(width);
+    float v = (static_cast<float>(y) + rowOffset) / static_cast<float>(height);
+
+    float theta = v * Utils::Pi;
+    float phi = (u - 0.5f) * 2.0f * Utils::Pi;
+    float sinTheta = std::sin(theta);
+
+    LightSample sample;
+    sample.direction = glm::vec3(sinTheta * std::sin(phi), std::cos(theta), -sinTheta * std::cos(phi));
+
+    // Texels map to the sphere with a Jacobian of 2 pi^2 sin(theta) per unit of texture area
+    size_t index = static_cast<size_t>(y) * width + x;
+    sample.pdf = sinTheta > 0.0f ? probabilities[index] * static_cast<float>(width * height) / (2.0f * Utils::Pi * Utils::Pi * sinTheta) : 0.0f;
+    sample.irradiance = sample.pdf > 0.0f ? texels[index] / sample.pdf : glm::vec3(0.0f);
+
+    return sample;
+}
+
+float EnvironmentMap::Pdf(const glm::vec3& direction) const {
+    float sinTheta = std::sqrt(glm::max(1.0f - direction.y * direction.y, 0.0f));
+
+    if (sinTheta <= 0.0f) {
+        return 0.0f;
+    }
+
+    return probabilities[TexelIndex(direction)] * static_cast<float>(width * height) / (2.0f * Utils::Pi * Utils::Pi * sinTheta);
+}
+
+glm::vec3 EnvironmentMap::Radiance(const glm::vec3& direction) const {
+    return texels[TexelIndex(direction)];
+}
+
+uint32_t EnvironmentMap::TexelIndex(const glm::vec3& direction) const {
+    float u = 0.5f + std::atan2(direction.x, -direction.z) / (2.0f * Utils::Pi);
+    float v = std::acos(glm::clamp(direction.y, -1.0f, 1.0f)) / Utils::Pi;
+
+    uint32_t x = std::min(static_cast<uint32_t>(glm::max(u, 0.0f) * static_cast<float>(width)), width - 1);
+    uint32_t y = std::min(static_cast<uint32_t>(glm::max(v, 0.0f) * static_cast<float>(height)), height - 1);
+
+    return y * width + x;
+}
+
+uint32_t EnvironmentMap::SampleCdf(const float* cdf, uint32_t count, float value, float& offset) {
+    // The first entry above the value ends its bucket, which skips buckets of zero width
+    const float* end = std::upper_bound(cdf + 1, cdf + count + 1, value);
+    uint32_t index = std::min(static_cast<uint32_t>(end - cdf) - 1, count - 1);
+
+    float bucket = cdf[index + 1] - cdf[index];
+    offset = bucket > 0.0f ? glm::clamp((value - cdf[index]) / bucket, 0.0f, 1.0f) : 0.0f;
+
+    return index;
+}
@@ -0,0 +1,59 @@
+//
+//  EnvironmentMap.h
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#pragma once
+
+#include "Light.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Radiance arriving from infinitely far away, from an equirectangular HDR image: u follows the angle around the y
+// axis, with -z in the middle, and v the angle down from +y. Each texel is constant over its patch of the sphere,
+// and sampled in proportion to the power it delivers, from tables built once when the map is made.
+class EnvironmentMap {
+
+public:
+
+    EnvironmentMap() = default;
+    // rgba holds width * height texels of four floats, rows top to bottom, as stbi_loadf returns them
+    EnvironmentMap(uint32_t width, uint32_t height, const float* rgba);
+
+    uint32_t GetWidth() const { return width; }
+    uint32_t GetHeight() const { return height; }
+
+    // A direction picked in proportion to the luminance of its texel. The irradiance is radiance over the density.
+    LightSample SampleDirection(const glm::vec2& random) const;
+
+    // Density of SampleDirection picking the direction
+    float Pdf(const glm::vec3& direction) const;
+
+    glm::vec3 Radiance(const glm::vec3& direction) const;
+
+private:
+
+    uint32_t TexelIndex(const glm::vec3& direction) const;
+
+    // Finds the bucket of cdf, of count + 1 ascending values from 0 to 1, that value falls in, and how far into it
+    static uint32_t SampleCdf(const float* cdf, uint32_t count, float value, float& offset);
+
+private:
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    std::vector<glm::vec3> texels;
+
+    // Probability of picking each texel, its luminance times the solid angle its row covers, over the total
+    std::vector<float> probabilities;
+
+    // Picks a row, then a texel within it: width + 1 entries for every row, and height + 1 for the rows
+    std::vector<float> conditionalCdfs;
+    std::vector<float> marginalCdf;
+};
@@ -0,0 +1,19 @@
+//
+//  Framebuffer.h
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// The renderer's output: RGBA8 pixels, one uint32_t per pixel with red in the low byte, bottom row first. The
+// application uploads it to a texture and the command line renderer writes it to disk.
+struct Framebuffer {
+    std::vector<uint32_t> pixels;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
@@ -0,0 +1,138 @@
+//
+//  Light.cpp
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#include "Light.h"
+
+#include "ShadingFrame.h"
+
+#include <cmath>
+#include <limits>
+
+namespace Utils {
+
+    static constexpr float Pi = 3.14159265358979f;
+}
+
+DirectionalLight::DirectionalLight(const glm::vec3& direction, float angularRadius, float irradiance) :
+    toLight(-glm::normalize(direction)),
+    cosRadius(std::cos(angularRadius)),
+    irradiance(irradiance)
+{
+    solidAngle = angularRadius > 0.0f ? 2.0f * Utils::Pi * (1.0f - cosRadius) : 0.0f;
+}
+
+LightSample DirectionalLight::SampleDirection(const glm::vec2& random) const {
+    LightSample sample;
+
+    if (IsDelta()) {
+        sample.direction = toLight;
+        sample.irradiance = glm::vec3(irradiance);
+        sample.pdf = std::numeric_limits<float>::infinity();
+
+        return sample;
+    }
+
+    // Uniform in solid angle: the cosine to the axis is uniform between cosRadius and 1
+    float cosTheta = 1.0f - random.x * (1.0f - cosRadius);
+    float sinTheta = std::sqrt(glm::max(1.0f - cosTheta * cosTheta, 0.0f));
+    float phi = 2.0f * Utils::Pi * random.y;
+
+    ShadingFrame frame(toLight);
+
+    sample.direction = frame.ToWorld(glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta));
+    sample.irradiance = glm::vec3(irradiance);
+    sample.pdf = 1.0f / solidAngle;
+
+    return sample;
+}
+
+float DirectionalLight::Pdf(const glm::vec3& direction) const {
+    if (IsDelta() || glm::dot(direction, toLight) < cosRadius) {
+        return 0.0f;
+    }
+
+    return 1.0f / solidAngle;
+}
+
+float DirectionalLight::Radiance(const glm::vec3& direction) const {
+    if (IsDelta() || glm::dot(direction, toLight) < cosRadius) {
+        return 0.0f;
+    }
+
+    return irradiance / solidAngle;
+}
+
+SphereLight::SphereLight(const glm::vec3& position, float radius, const glm::vec3& radiance) :
+    position(position),
+    radius(glm::abs(radius)),
+    radiance(radiance)
+{
+}
+
+LightSample SphereLight::SampleDirection(const glm::vec3& point, const glm::vec2& random) const {
+    LightSample sample;
+    sample.direction = glm::vec3(0.0f, 1.0f, 0.0f);
+    sample.irradiance = glm::vec3(0.0f);
+    sample.pdf = 0.0f;
+
+    float coneSize = ConeSize(point);
+
+    if (coneSize <= 0.0f) {
+        return sample;
+    }
+
+    glm::vec3 toCenter = position - point;
+    float distance = glm::length(toCenter);
+    toCenter /= distance;
+
+    // Uniform in solid angle over the cone, like the directional light. The sine comes from 1 - cos directly, since
+    // cos is too close to 1 for small cones.
+    float oneMinusCos = random.x * coneSize;
+    float cosTheta = 1.0f - oneMinusCos;
+    float sinTheta = std::sqrt(glm::max(oneMinusCos * (2.0f - oneMinusCos), 0.0f));
+    float phi = 2.0f * Utils::Pi * random.y;
+
+    ShadingFrame frame(toCenter);
+
+    sample.direction = frame.ToWorld(glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta));
+    sample.pdf = 1.0f / (2.0f * Utils::Pi * coneSize);
+    sample.irradiance = radiance / sample.pdf;
+
+    // Near side of the sphere along the direction. Directions at the cone's edge graze it, where rounding can make
+    // the discriminant slightly negative.
+    float offset = distance * sinTheta;
+    float discriminant = glm::max(radius * radius - offset * offset, 0.0f);
+    sample.distance = distance * cosTheta - std::sqrt(discriminant);
+
+    return sample;
+}
+
+float SphereLight::Pdf(const glm::vec3& point) const {
+    float coneSize = ConeSize(point);
+
+    return coneSize > 0.0f ? 1.0f / (2.0f * Utils::Pi * coneSize) : 0.0f;
+}
+
+float SphereLight::Power() const {
+    return glm::dot(radiance, glm::vec3(0.2126f, 0.7152f, 0.0722f)) * radius * radius;
+}
+
+float SphereLight::ConeSize(const glm::vec3& point) const {
+    glm::vec3 toCenter = position - point;
+    float distanceSquared = glm::dot(toCenter, toCenter);
+    float radiusSquared = radius * radius;
+
+    if (distanceSquared <= radiusSquared) {
+        return 0.0f;
+    }
+
+    // 1 - cos written with the sine, which keeps its precision for small, distant spheres
+    float sinSquared = radiusSquared / distanceSquared;
+    float cosTheta = std::sqrt(1.0f - sinSquared);
+
+    return sinSquared / (1.0f + cosTheta);
+}
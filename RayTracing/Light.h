@@ -0,0 +1,85 @@
+//
+//  Light.h
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <limits>
+
+// A direction toward a light, as picked by one of the lights' SampleDirection
+struct LightSample {
+    glm::vec3 direction;  // Toward the light
+    glm::vec3 irradiance; // Radiance divided by the density, the light's share of the estimate
+    float pdf;            // Per unit solid angle, infinite for a delta light
+
+    // How far the shadow ray has to reach. Distant lights leave it unbounded.
+    float distance = std::numeric_limits<float>::infinity();
+};
+
+// A distant light with an angular size, like the sun: every direction within angularRadius of the direction toward
+// the light carries the same radiance, the given irradiance spread over the cone's solid angle. With a radius of 0
+// it is a delta light, which only light sampling can find.
+class DirectionalLight {
+
+public:
+
+    DirectionalLight() = default;
+    // direction is the way the light travels, away from the light
+    DirectionalLight(const glm::vec3& direction, float angularRadius, float irradiance);
+
+    bool IsDelta() const { return solidAngle == 0.0f; }
+
+    // A direction uniformly distributed over the light's cone
+    LightSample SampleDirection(const glm::vec2& random) const;
+
+    // Density of SampleDirection picking the direction, 0 outside the cone and for a delta light
+    float Pdf(const glm::vec3& direction) const;
+
+    // Radiance arriving from the direction, 0 outside the cone and for a delta light
+    float Radiance(const glm::vec3& direction) const;
+
+private:
+
+    glm::vec3 toLight { 0.0f, 1.0f, 0.0f };
+    float cosRadius = 1.0f;
+    float solidAngle = 0.0f;
+    float irradiance = 0.0f;
+};
+
+// A sphere whose surface emits the same radiance everywhere and in every direction
+class SphereLight {
+
+public:
+
+    SphereLight() = default;
+    SphereLight(const glm::vec3& position, float radius, const glm::vec3& radiance);
+
+    // A direction uniformly distributed over the cone the sphere covers as seen from point, with the distance to the
+    // sphere's surface along it. The pdf is 0 when the point is inside the sphere.
+    LightSample SampleDirection(const glm::vec3& point, const glm::vec2& random) const;
+
+    // Density of SampleDirection picking any direction toward the sphere from point
+    float Pdf(const glm::vec3& point) const;
+
+    // Proportional to the flux the sphere emits, for weighing lights against each other
+    float Power() const;
+
+    const glm::vec3& GetPosition() const { return position; }
+    float GetRadius() const { return radius; }
+
+private:
+
+    // 1 - cos of the cone's half angle, or 0 when the point is inside the sphere
+    float ConeSize(const glm::vec3& point) const;
+
+private:
+
+    glm::vec3 position { 0.0f };
+    float radius = 0.0f;
+    glm::vec3 radiance { 0.0f };
+};
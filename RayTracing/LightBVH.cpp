@@ -0,0 +1,240 @@
+//
+//  LightBVH.cpp
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#include "LightBVH.h"
+
+#include "BVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace Utils {
+
+    static bool IsEmissive(const Material& material) {
+        glm::vec3 emission = material.GetEmission();
+
+        return emission.r > 0.0f || emission.g > 0.0f || emission.b > 0.0f;
+    }
+}
+
+void LightBVH::Build(const Scene& scene) {
+    nodes.clear();
+    lights.clear();
+    lightTrails.clear();
+    sphereLights.assign(scene.spheres.size(), -1);
+
+    for (uint32_t sphereIndex = 0; sphereIndex < scene.spheres.size(); sphereIndex += 1) {
+        const Sphere& sphere = scene.spheres[sphereIndex];
+
+        if (sphere.radius != 0.0f && Utils::IsEmissive(scene.materials[sphere.materialIndex])) {
+            sphereLights[sphereIndex] = static_cast<int32_t>(lights.size());
+            lights.emplace_back(sphere.position, sphere.radius, scene.materials[sphere.materialIndex].GetEmission());
+        }
+    }
+
+    if (lights.empty()) {
+        return;
+    }
+
+    uint32_t lightCount = static_cast<uint32_t>(lights.size());
+
+    std::vector<uint32_t> order(lightCount);
+    std::iota(order.begin(), order.end(), 0);
+
+    // Leaves hold one light each, so the tree is full
+    nodes.reserve(lightCount * 2 - 1);
+    nodes.emplace_back();
+
+    lightTrails.resize(lightCount);
+
+    Subdivide(0, order, 0, lightCount, 0, 0);
+}
+
+bool LightBVH::Sample(const glm::vec3& point, const glm::vec3& normal, float random, const SphereLight*& light, float& probability) const {
+    if (nodes.empty()) {
+        return false;
+    }
+
+    uint32_t nodeIndex = 0;
+    probability = 1.0f;
+
+    while (!nodes[nodeIndex].isLeaf) {
+        const Node& node = nodes[nodeIndex];
+
+        float leftImportance = Importance(nodes[node.leftFirst], point, normal);
+        float rightImportance = Importance(nodes[node.leftFirst + 1], point, normal);
+        float total = leftImportance + rightImportance;
+
+        if (total <= 0.0f) {
+            return false;
+        }
+
+        // The random value is reused at every level, rescaled to the part of [0, 1) it fell into
+        float leftProbability = leftImportance / total;
+
+        if (random < leftProbability) {
+            random = glm::min(random / leftProbability, 0.99999994f);
+            probability *= leftProbability;
+            nodeIndex = node.leftFirst;
+        } else {
+            random = glm::min((random - leftProbability) / (1.0f - leftProbability), 0.99999994f);
+            probability *= 1.0f - leftProbability;
+            nodeIndex = node.leftFirst + 1;
+        }
+    }
+
+    // A single light, or the root leaf, still has to be able to reach the point
+    if (nodeIndex == 0 && Importance(nodes[0], point, normal) <= 0.0f) {
+        return false;
+    }
+
+    light = &lights[nodes[nodeIndex].leftFirst];
+
+    return true;
+}
+
+float LightBVH::Probability(const glm::vec3& point, const glm::vec3& normal, uint32_t sphereIndex) const {
+    if (sphereIndex >= sphereLights.size() || sphereLights[sphereIndex] < 0) {
+        return 0.0f;
+    }
+
+    // Follows the light's trail down from the root, taking the same choices Sample would have had to make
+    uint64_t trail = lightTrails[sphereLights[sphereIndex]];
+    uint32_t nodeIndex = 0;
+    float probability = 1.0f;
+
+    while (!nodes[nodeIndex].isLeaf) {
+        const Node& node = nodes[nodeIndex];
+
+        float leftImportance = Importance(nodes[node.leftFirst], point, normal);
+        float rightImportance = Importance(nodes[node.leftFirst + 1], point, normal);
+        float total = leftImportance + rightImportance;
+
+        if (total <= 0.0f) {
+            return 0.0f;
+        }
+
+        bool right = (trail & 1) != 0;
+        trail >>= 1;
+
+        probability *= (right ? rightImportance : leftImportance) / total;
+        nodeIndex = node.leftFirst + (right ? 1 : 0);
+    }
+
+    if (nodeIndex == 0 && Importance(nodes[0], point, normal) <= 0.0f) {
+        return 0.0f;
+    }
+
+    return probability;
+}
+
+float LightBVH::Pdf(const glm::vec3& point, const glm::vec3& normal, uint32_t sphereIndex) const {
+    float probability = Probability(point, normal, sphereIndex);
+
+    if (probability <= 0.0f) {
+        return 0.0f;
+    }
+
+    return probability * lights[sphereLights[sphereIndex]].Pdf(point);
+}
+
+void LightBVH::Subdivide(uint32_t nodeIndex, std::vector<uint32_t>& order, uint32_t first, uint32_t count, uint64_t trail, uint32_t depth) {
+    AABB bounds;
+    AABB centers;
+    float power = 0.0f;
+
+    for (uint32_t index = first; index < first + count; index += 1) {
+        const SphereLight& light = lights[order[index]];
+
+        bounds.Grow(light.GetPosition() - glm::vec3(light.GetRadius()));
+        bounds.Grow(light.GetPosition() + glm::vec3(light.GetRadius()));
+        centers.Grow(light.GetPosition());
+
+        power += light.Power();
+    }
+
+    Node& node = nodes[nodeIndex];
+    node.boundsMin = bounds.min;
+    node.boundsMax = bounds.max;
+    node.power = power;
+
+    if (count == 1) {
+        node.leftFirst = order[first];
+        node.isLeaf = true;
+
+        lightTrails[order[first]] = trail;
+
+        return;
+    }
+
+    glm::vec3 extent = centers.max - centers.min;
+    int axis = 0;
+
+    if (extent.y > extent.x) {
+        axis = 1;
+    }
+
+    if (extent.z > extent[axis]) {
+        axis = 2;
+    }
+
+    uint32_t leftCount = count / 2;
+
+    auto begin = order.begin() + first;
+
+    std::nth_element(begin, begin + leftCount, begin + count, [this, axis](uint32_t a, uint32_t b) {
+        return lights[a].GetPosition()[axis] < lights[b].GetPosition()[axis];
+    });
+
+    uint32_t leftChild = static_cast<uint32_t>(nodes.size());
+
+    node.leftFirst = leftChild;
+    node.isLeaf = false;
+
+    // Reserved up front, so node stays valid
+    nodes.emplace_back();
+    nodes.emplace_back();
+
+    // Median splits keep the depth at log2 of the light count, far below the 64 turns a trail holds
+    Subdivide(leftChild, order, first, leftCount, trail, depth + 1);
+    Subdivide(leftChild + 1, order, first + leftCount, count - leftCount, trail | (uint64_t(1) << depth), depth + 1);
+}
+
+float LightBVH::Importance(const Node& node, const glm::vec3& point, const glm::vec3& normal) {
+    if (node.power <= 0.0f) {
+        return 0.0f;
+    }
+
+    // The bounds are treated as the sphere around them
+    glm::vec3 center = (node.boundsMin + node.boundsMax) * 0.5f;
+    float radiusSquared = glm::dot(node.boundsMax - center, node.boundsMax - center);
+
+    glm::vec3 toCenter = center - point;
+    float distanceSquared = glm::dot(toCenter, toCenter);
+
+    // Inside the bounds, light can come from any direction, and the distance says nothing
+    if (distanceSquared <= radiusSquared) {
+        return node.power / glm::max(radiusSquared, 1e-8f);
+    }
+
+    // The smallest angle between the normal and any direction into the bounds: the angle to the center, less the
+    // angle the bounds cover. Nothing in the bounds can light the surface once that is past 90 degrees.
+    float distance = std::sqrt(distanceSquared);
+    float sinBounds = std::sqrt(radiusSquared) / distance;
+    float cosBounds = std::sqrt(glm::max(1.0f - sinBounds * sinBounds, 0.0f));
+
+    float cosCenter = glm::dot(normal, toCenter) / distance;
+    float cosAngle = 1.0f;
+
+    if (cosCenter < cosBounds) {
+        float sinCenter = std::sqrt(glm::max(1.0f - cosCenter * cosCenter, 0.0f));
+        cosAngle = glm::max(cosCenter * cosBounds + sinCenter * sinBounds, 0.0f);
+    }
+
+    return node.power * cosAngle / distanceSquared;
+}
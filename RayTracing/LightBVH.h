@@ -0,0 +1,78 @@
+//
+//  LightBVH.h
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Light.h"
+#include "Scene.h"
+
+#include <cstdint>
+#include <vector>
+
+// A hierarchy over the emissive spheres of a scene, for picking one light per shading point in proportion to an
+// estimate of how much it contributes there. Every node bounds its lights and sums their power. A light is picked by
+// walking down from the root, choosing between the two children by the power of each over its squared distance,
+// times the largest cosine any point of its bounds can make with the surface normal, so the cost of a pick grows
+// with the depth of the tree rather than the number of lights.
+//
+// Spheres emit in every direction, so unlike lights with an emission cone, the bounds need no cone of their own and
+// only the receiving surface's orientation is bounded.
+class LightBVH {
+
+public:
+
+    struct Node {
+        glm::vec3 boundsMin;
+        uint32_t leftFirst; // Left child for interior nodes (right is leftFirst + 1), the light for leaves
+        glm::vec3 boundsMax;
+        float power;
+
+        bool isLeaf;
+    };
+
+public:
+
+    LightBVH() = default;
+
+    // Collects the spheres with an emissive material and builds the tree over them by median splits
+    void Build(const Scene& scene);
+
+    bool IsEmpty() const { return lights.empty(); }
+    size_t GetLightCount() const { return lights.size(); }
+
+    // Spheres of the scene the tree was built for, emissive or not
+    size_t GetSphereCount() const { return sphereLights.size(); }
+
+    // Picks a light for the surface at point with the given normal. Returns false when no light can reach it.
+    bool Sample(const glm::vec3& point, const glm::vec3& normal, float random, const SphereLight*& light, float& probability) const;
+
+    // Probability of Sample picking the light of the given sphere, 0 when the sphere does not emit
+    float Probability(const glm::vec3& point, const glm::vec3& normal, uint32_t sphereIndex) const;
+
+    // Density of picking the light of the given sphere and then a direction toward it
+    float Pdf(const glm::vec3& point, const glm::vec3& normal, uint32_t sphereIndex) const;
+
+private:
+
+    // Splits the lights of order[first, first + count) at the median along the longest axis of their centers
+    void Subdivide(uint32_t nodeIndex, std::vector<uint32_t>& order, uint32_t first, uint32_t count, uint64_t trail, uint32_t depth);
+
+    static float Importance(const Node& node, const glm::vec3& point, const glm::vec3& normal);
+
+private:
+
+    std::vector<Node> nodes;
+    std::vector<SphereLight> lights;
+
+    // The turns from the root to each light's leaf, one bit per level with the first turn lowest, 1 for right
+    std::vector<uint64_t> lightTrails;
+
+    // Light of every sphere of the scene, -1 for spheres that do not emit
+    std::vector<int32_t> sphereLights;
+};
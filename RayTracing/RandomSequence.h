@@ -0,0 +1,58 @@
+//
+//  RandomSequence.h
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+// Counter-based random numbers for one path. The n-th value is a hash of the pixel, the frame and n, so a sample
+// does not depend on which thread renders it or in what order, and renders are identical across worker counts and
+// integrators. The whole state is 8 bytes, cheap enough to carry along with every wavefront path.
+class RandomSequence {
+
+public:
+
+    RandomSequence() = default;
+
+    RandomSequence(uint32_t pixelIndex, uint32_t frameIndex) :
+        key(Hash(pixelIndex ^ Hash(frameIndex)))
+    {
+    }
+
+    uint32_t UInt() {
+        // The golden ratio step keeps consecutive counters far apart before hashing
+        return Hash(key + counter++ * 0x9E3779B9u);
+    }
+
+    // Uniform in [0, 1). The top 24 bits fit a float's mantissa exactly.
+    float Float() {
+        return static_cast<float>(UInt() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    glm::vec3 Vec3(float min, float max) {
+        float x = Float();
+        float y = Float();
+        float z = Float();
+
+        return glm::vec3(x, y, z) * (max - min) + min;
+    }
+
+    // PCG output permutation (RXS-M-XS) applied to one LCG step, a well mixed 32-bit hash
+    static uint32_t Hash(uint32_t value) {
+        uint32_t state = value * 747796405u + 2891336453u;
+        uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+
+        return (word >> 22u) ^ word;
+    }
+
+private:
+
+    uint32_t key = 0;
+    uint32_t counter = 0;
+};
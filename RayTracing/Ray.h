@@ -9,7 +9,71 @@
 
 #include <glm/glm.hpp>
 
+#include <limits>
+
 struct Ray {
     glm::vec3 origin;
     glm::vec3 direction;
 };
+
+// A tile of primary rays sharing the camera origin, stored structure-of-arrays so the 4-wide kernels can test a
+// group of rays per instruction. Partial tiles at the image edge repeat their last ray to fill the packet.
+struct RayPacket {
+    static constexpr int TileSize = 4;
+    static constexpr int Size = TileSize * TileSize;
+
+    glm::vec3 origin;
+
+    alignas(16) float directionX[Size];
+    alignas(16) float directionY[Size];
+    alignas(16) float directionZ[Size];
+
+    alignas(16) float inverseX[Size];
+    alignas(16) float inverseY[Size];
+    alignas(16) float inverseZ[Size];
+
+    // Per-axis range of the inverse directions. Only meaningful when every ray has the same direction sign on every
+    // axis, which is what allows culling a box against the whole packet at once.
+    glm::vec3 inverseMin;
+    glm::vec3 inverseMax;
+    bool signsMatch;
+
+    void SetDirection(int index, const glm::vec3& direction) {
+        directionX[index] = direction.x;
+        directionY[index] = direction.y;
+        directionZ[index] = direction.z;
+    }
+
+    Ray GetRay(int index) const {
+        return Ray { origin, { directionX[index], directionY[index], directionZ[index] } };
+    }
+
+    // Call once every direction is set
+    void Finalize() {
+        inverseMin = glm::vec3(std::numeric_limits<float>::max());
+        inverseMax = glm::vec3(-std::numeric_limits<float>::max());
+
+        int positive[3] = { 0, 0, 0 };
+
+        for (int index = 0; index < Size; index++) {
+            glm::vec3 inverse = 1.0f / glm::vec3(directionX[index], directionY[index], directionZ[index]);
+
+            inverseX[index] = inverse.x;
+            inverseY[index] = inverse.y;
+            inverseZ[index] = inverse.z;
+
+            inverseMin = glm::min(inverseMin, inverse);
+            inverseMax = glm::max(inverseMax, inverse);
+
+            positive[0] += directionX[index] >= 0.0f ? 1 : 0;
+            positive[1] += directionY[index] >= 0.0f ? 1 : 0;
+            positive[2] += directionZ[index] >= 0.0f ? 1 : 0;
+        }
+
+        signsMatch = true;
+
+        for (int axis = 0; axis < 3; axis++) {
+            signsMatch &= positive[axis] == 0 || positive[axis] == Size;
+        }
+    }
+};
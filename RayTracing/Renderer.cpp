@@ -7,13 +7,103 @@
 
 #include "Renderer.h"
 
-#include <Walnut/Random.h>
+#include <Walnut/Timer.h>
 
-#define PSTLD_HEADER_ONLY
-#define PSTLD_HACK_INTO_STD
-#include <pstld/pstld.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 
 namespace Utils {
+    
+    // Per-thread traversal counters. Each tile is rendered entirely on one thread, so the tile task resets these,
+    // renders, and folds them into the frame totals with a single atomic add per tile.
+    struct TraceCounters {
+        uint64_t raysTraced = 0;
+        uint64_t nodesVisited = 0;
+    };
+    
+    static thread_local TraceCounters traceCounters;
+    
+    // Irradiance from the directional light. Pi makes a white diffuse surface facing the light exactly white.
+    static constexpr float LightIrradiance = 3.14159265f;
+    
+    // Weight of a sample from the strategy with density pdf, against the other strategy's otherPdf for the same
+    // direction. Squaring favours whichever strategy is clearly better more strongly than the balance heuristic.
+    static float PowerHeuristic(float pdf, float otherPdf) {
+        return (pdf * pdf) / (pdf * pdf + otherPdf * otherPdf);
+    }
+    
+    // A reprojected tap is only kept when its distance from the old camera is within this fraction of the one
+    // expected, and its normal is within about 25 degrees of the new one
+    static constexpr float ReprojectionDepthTolerance = 0.05f;
+    static constexpr float ReprojectionNormalTolerance = 0.9f;
+    
+    // Largest block edge dynamic resolution renders one pixel of, so moving renders at least 1/16 of the pixels
+    static constexpr uint32_t MaxInterleaveScale = 4;
+    
+    // First coordinate at or after first that is offset past a multiple of scale
+    static uint32_t FirstInterleaved(uint32_t first, uint32_t offset, uint32_t scale) {
+        return first + (offset + scale - first % scale) % scale;
+    }
+    
+    // Coordinates below size that are offset past a multiple of scale
+    static uint32_t InterleavedCount(uint32_t size, uint32_t offset, uint32_t scale) {
+        return offset < size ? (size - offset + scale - 1) / scale : 0;
+    }
+    
+    // Sorts values stably on the scheduler's workers. Each worker's share is sorted on its own, then neighbouring
+    // runs are merged pairwise, halving the number of runs every round.
+    template<typename Compare>
+    static void ParallelSort(TileScheduler& scheduler, std::vector<uint32_t>& values, const Compare& compare) {
+        size_t count = values.size();
+        size_t runCount = std::max<size_t>(1, std::min<size_t>(scheduler.GetWorkerCount(), count / 4096));
+        size_t runSize = (count + runCount - 1) / runCount;
+        
+        auto begin = values.begin();
+        
+        scheduler.Run(static_cast<uint32_t>(runCount), [&](uint32_t run, uint32_t) {
+            size_t first = std::min(run * runSize, count);
+            size_t last = std::min(first + runSize, count);
+            
+            std::stable_sort(begin + first, begin + last, compare);
+        });
+        
+        for (size_t width = runSize; width < count; width *= 2) {
+            size_t pairCount = (count + 2 * width - 1) / (2 * width);
+            
+            scheduler.Run(static_cast<uint32_t>(pairCount), [&](uint32_t pair, uint32_t) {
+                size_t first = pair * 2 * width;
+                size_t middle = std::min(first + width, count);
+                size_t last = std::min(first + 2 * width, count);
+                
+                if (middle < last) {
+                    std::inplace_merge(begin + first, begin + middle, begin + last, compare);
+                }
+            });
+        }
+    }
+    
+    // Paths handed to one task by each wavefront stage
+    static constexpr uint32_t WavefrontBatchSize = 1024;
+
+    // Interleaves the lower 16 bits of x and y, x in the even bits
+    static uint32_t MortonCode2D(uint32_t x, uint32_t y) {
+        auto spread = [](uint32_t value) {
+            value &= 0x0000FFFF;
+            value = (value | (value << 8)) & 0x00FF00FF;
+            value = (value | (value << 4)) & 0x0F0F0F0F;
+            value = (value | (value << 2)) & 0x33333333;
+            value = (value | (value << 1)) & 0x55555555;
+            
+            return value;
+        };
+        
+        return spread(x) | (spread(y) << 1);
+    }
+
+    static float Luminance(const glm::vec3& color) {
+        return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+    }
 
     static uint32_t ConvertToRGBA(const glm::vec4& color) {
         uint8_t r = (uint8_t)(color.r * 255.0f);
@@ -27,126 +117,1281 @@ namespace Utils {
     }
 }
 
+Renderer::~Renderer() {
+    StopRenderThread();
+}
+
 void Renderer::OnResize(uint32_t width, uint32_t height) {
-    if (finalImage == nullptr) {
-        finalImage = std::make_shared<Walnut::Image>(width, height, Walnut::ImageFormat::RGBA);
-    } else {
-        if (finalImage->GetWidth() == width && finalImage->GetHeight() == height) {
-            return;
-        }
-        
-        finalImage->Resize(width, height);
+    ResizeBuffers(width, height);
+}
+
+void Renderer::ResizeBuffers(uint32_t width, uint32_t height) {
+    if (accumulationData != nullptr && imageWidth == width && imageHeight == height) {
+        return;
     }
     
-    delete[] imageData;
-    imageData = new uint32_t[width * height];
+    finalImage.pixels.assign(width * height, 0);
+    finalImage.width = width;
+    finalImage.height = height;
     
     delete[] accumulationData;
     accumulationData = new glm::vec4[width * height];
+    luminanceSquares.assign(width * height, 0.0f);
     
-    imageHorizontalIterator.resize(width);
-    imageVerticalIterator.resize(height);
+    albedoAOV.assign(width * height, glm::vec3(1.0f));
+    normalAOV.assign(width * height, glm::vec3(0.0f));
+    depthAOV.assign(width * height, 0.0f);
     
-    for (uint32_t index = 0; index < width; index += 1) {
-        imageHorizontalIterator[index] = index;
-    }
+    imageWidth = width;
+    imageHeight = height;
+    
+    frameIndex = 1;
+    pendingTiles.clear();
+    historyValid = false;
+}
+
+void Renderer::ResetFrameIndex() {
+    std::lock_guard<std::mutex> lock(submitMutex);
+    
+    resetRequested = true;
+    cancelRequested = true;
+    reprojectCameraMove = false;
+}
+
+void Renderer::OnCameraMoved() {
+    std::lock_guard<std::mutex> lock(submitMutex);
+    
+    cameraMoved = true;
+    reprojectCameraMove = settings.reprojection;
+    cancelRequested = true;
     
-    for (uint32_t index = 0; index <height; index += 1) {
-        imageVerticalIterator[index] = index;
+    if (!settings.reprojection) {
+        resetRequested = true;
     }
+}
+
+void Renderer::OnSceneChanged() {
+    std::lock_guard<std::mutex> lock(submitMutex);
+    accelerationDirty = true;
+    lightsDirty = true;
+}
+
+void Renderer::OnSphereChanged(uint32_t sphereIndex) {
+    std::lock_guard<std::mutex> lock(submitMutex);
+    dirtySpheres.push_back(sphereIndex);
+    lightsDirty = true;
+}
+
+void Renderer::OnMaterialChanged() {
+    std::lock_guard<std::mutex> lock(submitMutex);
+    lightsDirty = true;
+}
+
+void Renderer::TakeSceneEdits() {
+    rebuildRequested |= accelerationDirty;
+    refitSpheres.insert(refitSpheres.end(), dirtySpheres.begin(), dirtySpheres.end());
+    lightRebuildRequested |= lightsDirty;
+    reprojectRequested |= cameraMoved && reprojectCameraMove;
+    interactiveRequested |= cameraMoved;
     
-    frameIndex = 1;
+    accelerationDirty = false;
+    dirtySpheres.clear();
+    lightsDirty = false;
+    cameraMoved = false;
+    reprojectCameraMove = false;
 }
 
 void Renderer::Render(const Scene& scene, const Camera& camera) {
+    {
+        std::lock_guard<std::mutex> lock(submitMutex);
+        
+        TakeSceneEdits();
+        
+        activeSettings = settings;
+        activeLightDirection = lightDirection;
+        cancelRequested = false;
+    }
+    
+    RenderPass(scene, camera);
+}
+
+bool Renderer::RenderPass(const Scene& scene, const Camera& camera) {
     activeScene = &scene;
     activeCamera = &camera;
     
-    if (frameIndex == 1) {
-        memset(accumulationData, 0, finalImage->GetWidth() * finalImage->GetHeight() * sizeof(glm::vec4));
+    bool reproject = reprojectRequested;
+    reprojectRequested = false;
+    
+    bool interactive = interactiveRequested && activeSettings.dynamicResolution;
+    interactiveRequested = false;
+    
+    // Passes while moving render one pixel of each block, a different one each pass. Walking the diagonals of the
+    // block first spreads consecutive pixels apart.
+    interleaveScale = interactive ? interactiveScale : 1;
+    
+    uint32_t step = interleaveStep % (interleaveScale * interleaveScale);
+    interleaveStep += interactive ? 1 : 0;
+    
+    interleaveX = step % interleaveScale;
+    interleaveY = (step / interleaveScale + step % interleaveScale) % interleaveScale;
+    
+    // Without accumulation there is nothing to carry over
+    if (resetRequested.exchange(false) || (reproject && (!historyValid || !activeSettings.accumulate))) {
+        frameIndex = 1;
+        pendingTiles.clear();
+        reproject = false;
     }
     
-#define MT 1
+    Walnut::Timer timer;
+    
+    activeLight = DirectionalLight(activeLightDirection, glm::radians(activeSettings.lightAngle) * 0.5f, Utils::LightIrradiance);
+    
+    if (lightRebuildRequested || lightBVH.GetSphereCount() != scene.spheres.size()) {
+        lightBVH.Build(scene);
+        lightRebuildRequested = false;
+    }
+    
+    // Acceleration structure builds, reprojection and the denoiser all run on the render workers too
+    scheduler.Configure(activeSettings.workerCount, activeSettings.pinWorkers);
+    
+    UpdateAccelerationStructure(scene);
+    
+    if (reproject) {
+        ReprojectHistory();
+    }
     
+    historyViewProjection = camera.GetProjection() * camera.GetView();
+    historyPosition = camera.GetPosition();
+    historyValid = true;
+    
+    std::atomic<uint64_t> raysTraced = 0;
+    std::atomic<uint64_t> nodesVisited = 0;
+    std::atomic<uint64_t> samples = 0;
+    
+    // Without a budget there is no deadline, and every call renders exactly one full pass
+    auto deadline = std::chrono::high_resolution_clock::time_point::max();
+    
+    if (activeSettings.frameBudget > 0.0f) {
+        deadline = std::chrono::high_resolution_clock::now() + std::chrono::microseconds(static_cast<int64_t>(activeSettings.frameBudget * 1000.0f));
+    }
+    
+    bool passComplete = false;
+    
+    Walnut::Timer renderTimer;
+    
+    do {
+        // A pass left unfinished by the previous call carries on with the accumulation it started
+        if (frameIndex == 1 && pendingTiles.empty()) {
+            std::fill(accumulationData, accumulationData + imageWidth * imageHeight, glm::vec4(0.0f));
+            std::fill(luminanceSquares.begin(), luminanceSquares.end(), 0.0f);
+        }
+        
+        imageConverged = false;
+        
+#define MT 1
+        
 #if MT
-    std::for_each(std::execution::par, imageVerticalIterator.begin(), imageVerticalIterator.end(), [this](uint32_t y) {
-        std::for_each(imageHorizontalIterator.begin(), imageHorizontalIterator.end(), [this, y](uint32_t x) {
-            glm::vec4 color = PerPixel(x, y);
-            accumulationData[(y * finalImage->GetWidth()) + x] += color;
+        if (activeSettings.integrator == Integrator::Wavefront) {
+            RenderWavefront(raysTraced, nodesVisited);
             
-            glm::vec4 accumulatedColor = accumulationData[(y * finalImage->GetWidth()) + x];
-            accumulatedColor /= static_cast<float>(frameIndex);
+            samples += Utils::InterleavedCount(imageWidth, interleaveX, interleaveScale) * Utils::InterleavedCount(imageHeight, interleaveY, interleaveScale);
+            passComplete = true;
+        } else {
+            passComplete = RenderTiles(raysTraced, nodesVisited, samples, deadline);
+        }
+        
+        statistics.scheduler = scheduler.GetStatistics();
+#else
+        Utils::traceCounters = Utils::TraceCounters();
+
+        for (uint32_t y = interleaveY; y < imageHeight; y += interleaveScale) {
+            for (uint32_t x = interleaveX; x < imageWidth; x += interleaveScale) {
+                AccumulatePixel(x, y, PerPixel(x, y));
+            }
+        }
+        
+        raysTraced = Utils::traceCounters.raysTraced;
+        nodesVisited = Utils::traceCounters.nodesVisited;
+        
+        samples += Utils::InterleavedCount(imageWidth, interleaveX, interleaveScale) * Utils::InterleavedCount(imageHeight, interleaveY, interleaveScale);
+        passComplete = true;
+#endif
+        
+        // Some pixels have this pass accumulated and some do not, so the accumulation has to start over
+        if (cancelRequested) {
+            frameIndex = 1;
+            pendingTiles.clear();
             
-            accumulatedColor = glm::clamp(accumulatedColor, glm::vec4(0.0f), glm::vec4(1.0f));
+            return false;
+        }
+        
+        // A pass that skipped every tile added nothing, so it does not count
+        if (passComplete && !imageConverged) {
+            if (activeSettings.accumulate) {
+                frameIndex += 1;
+            } else {
+                frameIndex = 1;
+            }
+        }
+        
+        // Another pass only fits in with a budget, and without accumulation it would only overwrite this one. While
+        // moving, the next pass has to wait for the next camera anyway.
+    } while (passComplete && !imageConverged && !interactive && activeSettings.accumulate && activeSettings.frameBudget > 0.0f && std::chrono::high_resolution_clock::now() < deadline);
+    
+    float renderTime = renderTimer.ElapsedMillis();
+    
+    // An interleaved pass leaves holes in the accumulation, which are filled in for display only
+    bool interleaved = interleaveScale > 1 && !activeSettings.sampleHeatmap;
+    const glm::vec4* displayAccumulation = accumulationData;
+    const float* displaySquares = luminanceSquares.data();
+    
+    if (interleaved) {
+        UpsampleInterleaved();
+        
+        displayAccumulation = upsampledAccumulation.data();
+        displaySquares = upsampledSquares.data();
+    }
+    
+    // The heatmap, the denoised and the upsampled image cover the whole image, and once they are turned off, so
+    // does the color they covered
+    bool denoised = activeSettings.denoise && !activeSettings.sampleHeatmap;
+    statistics.denoiseTime = 0.0f;
+    
+    if (denoised) {
+        Walnut::Timer denoiseTimer;
+        DenoiseImage(displayAccumulation, displaySquares);
+        statistics.denoiseTime = denoiseTimer.ElapsedMillis();
+    } else if (activeSettings.sampleHeatmap || heatmapShown || denoisedShown || interleaved || interleavedShown) {
+        ResolveImage(displayAccumulation, activeSettings.sampleHeatmap);
+    }
+    
+    heatmapShown = activeSettings.sampleHeatmap;
+    denoisedShown = denoised;
+    interleavedShown = interleaved;
+    
+    statistics.renderScale = interleaveScale;
+    
+    if (interactive) {
+        UpdateInterleaveScale(timer.ElapsedMillis(), renderTime);
+    }
+    
+    statistics.raysTraced = raysTraced;
+    statistics.nodesVisited = nodesVisited;
+    
+    float seconds = timer.Elapsed();
+    statistics.samples = samples;
+    statistics.samplesPerSecond = seconds > 0.0f ? static_cast<float>(samples) / seconds : 0.0f;
+    statistics.passProgress = pendingTiles.empty() ? 1.0f : 1.0f - static_cast<float>(pendingTiles.size()) / static_cast<float>(tileOrder.size());
+    statistics.frameIndex = frameIndex;
+    statistics.convergedFraction = 0.0f;
+    
+    if (activeSettings.adaptiveSampling && !tileConverged.empty()) {
+        statistics.convergedFraction = static_cast<float>(std::count(tileConverged.begin(), tileConverged.end(), 1)) / static_cast<float>(tileConverged.size());
+    }
+    
+    statistics.accelerationStructure = bvh.GetStatistics();
+    statistics.accelerationQuality = bvh.GetQualityRatio();
+    statistics.rebuildingAccelerationStructure = pendingBuild.valid();
+    
+    return true;
+}
+
+void Renderer::StartRenderThread() {
+    if (IsRenderThreadRunning()) {
+        return;
+    }
+    
+    stopRequested = false;
+    frameReady = false;
+    
+    renderThread = std::thread(&Renderer::RenderThreadLoop, this);
+}
+
+void Renderer::StopRenderThread() {
+    if (!IsRenderThreadRunning()) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(submitMutex);
+        
+        stopRequested = true;
+        cancelRequested = true;
+    }
+    
+    submitted.notify_all();
+    renderThread.join();
+    
+    threadScene.reset();
+    threadCamera.reset();
+    pendingScene.reset();
+    pendingCamera.reset();
+}
 
-            imageData[(y * finalImage->GetWidth()) + x] = Utils::ConvertToRGBA(accumulatedColor);
+void Renderer::Submit(const Scene& scene, const Camera& camera, uint32_t width, uint32_t height) {
+    {
+        std::lock_guard<std::mutex> lock(submitMutex);
+        
+        pendingScene = scene;
+        pendingCamera = camera;
+        pendingWidth = width;
+        pendingHeight = height;
+        
+        pendingSettings = settings;
+        pendingLightDirection = lightDirection;
+        
+        // Under the lock, so it cannot land after the render thread picked this submission up and cancel that pass.
+        // A camera move alone is reprojected instead, once the render thread takes the new camera.
+        if (!cameraMoved || !reprojectCameraMove) {
+            resetRequested = true;
+        }
+        
+        cancelRequested = true;
+    }
+    
+    submitted.notify_all();
+}
+
+bool Renderer::Present() {
+    {
+        std::lock_guard<std::mutex> lock(submitMutex);
+        
+        pendingSettings = settings;
+        pendingLightDirection = lightDirection;
+        
+        if (!frameReady) {
+            return false;
+        }
+        
+        std::swap(readyFrame, presentFrame);
+        frameReady = false;
+    }
+    
+    return true;
+}
+
+void Renderer::RenderThreadLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(submitMutex);
+            
+            // Idle until there is a scene to render, then keep running passes until stopped
+            submitted.wait(lock, [this]() { return stopRequested || pendingScene.has_value() || threadScene.has_value(); });
+            
+            if (stopRequested) {
+                return;
+            }
+            
+            if (pendingScene.has_value()) {
+                threadScene = std::move(pendingScene);
+                threadCamera = std::move(pendingCamera);
+                pendingScene.reset();
+                pendingCamera.reset();
+                
+                ResizeBuffers(pendingWidth, pendingHeight);
+                TakeSceneEdits();
+            }
+            
+            activeSettings = pendingSettings;
+            activeLightDirection = pendingLightDirection;
+            cancelRequested = false;
+            
+            // A collapsed viewport has nothing to render, so wait for the next submission
+            if (imageWidth == 0 || imageHeight == 0) {
+                threadScene.reset();
+                continue;
+            }
+        }
+        
+        if (!RenderPass(*threadScene, *threadCamera)) {
+            continue;
+        }
+        
+        Frame& frame = frames[writeFrame];
+        frame.image = finalImage;
+        frame.statistics = statistics;
+        
+        {
+            std::lock_guard<std::mutex> lock(submitMutex);
+            
+            std::swap(writeFrame, readyFrame);
+            frameReady = true;
+        }
+    }
+}
+
+bool Renderer::RenderTiles(std::atomic<uint64_t>& raysTraced, std::atomic<uint64_t>& nodesVisited, std::atomic<uint64_t>& samples, std::chrono::high_resolution_clock::time_point deadline) {
+    uint32_t width = imageWidth;
+    uint32_t height = imageHeight;
+    
+    // A whole number of packets per tile, so no packet straddles two tiles
+    uint32_t tileSize = std::max((activeSettings.tileSize + RayPacket::TileSize - 1) / RayPacket::TileSize, 1u) * RayPacket::TileSize;
+    uint32_t tileColumns = (width + tileSize - 1) / tileSize;
+    uint32_t tileRows = (height + tileSize - 1) / tileSize;
+    
+    // Morton order keeps each worker's contiguous run of tiles in a compact block of the image
+    if (tileColumns != statistics.tileColumns || tileRows != statistics.tileRows) {
+        tileOrder.resize(tileColumns * tileRows);
+        
+        for (uint32_t index = 0; index < tileOrder.size(); index += 1) {
+            tileOrder[index] = index;
+        }
+        
+        std::sort(tileOrder.begin(), tileOrder.end(), [tileColumns](uint32_t lhs, uint32_t rhs) {
+            return Utils::MortonCode2D(lhs % tileColumns, lhs / tileColumns) < Utils::MortonCode2D(rhs % tileColumns, rhs / tileColumns);
         });
+        
+        statistics.tileColumns = tileColumns;
+        statistics.tileRows = tileRows;
+        
+        // Tiles left over from the old grid cannot be matched to the new one, so their pass starts over
+        if (!pendingTiles.empty()) {
+            pendingTiles.clear();
+            frameIndex = 1;
+        }
+    }
+    
+    statistics.tileTimes.resize(tileOrder.size());
+    tileFinished.assign(tileOrder.size(), 0);
+    
+    auto tileBounds = [=](uint32_t tileIndex, uint32_t& firstX, uint32_t& firstY, uint32_t& lastX, uint32_t& lastY) {
+        firstX = (tileIndex % tileColumns) * tileSize;
+        firstY = (tileIndex / tileColumns) * tileSize;
+        lastX = std::min(firstX + tileSize, width);
+        lastY = std::min(firstY + tileSize, height);
+    };
+    
+    if (pendingTiles.empty()) {
+        pendingTiles = tileOrder;
+        
+        // Converged tiles sit the pass out, leaving its time to the noisy ones. Every tile is judged again at the
+        // start of each pass, so a lower threshold brings converged tiles back.
+        if (activeSettings.adaptiveSampling) {
+            tileConverged.resize(tileOrder.size());
+            
+            scheduler.Run(static_cast<uint32_t>(tileOrder.size()), [&](uint32_t tileIndex, uint32_t) {
+                uint32_t firstX, firstY, lastX, lastY;
+                tileBounds(tileIndex, firstX, firstY, lastX, lastY);
+                
+                tileConverged[tileIndex] = IsTileConverged(firstX, firstY, lastX, lastY) ? 1 : 0;
+            });
+            
+            pendingTiles.erase(std::remove_if(pendingTiles.begin(), pendingTiles.end(), [this](uint32_t tileIndex) {
+                return tileConverged[tileIndex] != 0;
+            }), pendingTiles.end());
+            
+            imageConverged = pendingTiles.empty();
+        }
+    }
+    
+    std::atomic<bool> anyStarted = false;
+    
+    scheduler.Run(pendingTiles, [&](uint32_t tileIndex, uint32_t) {
+        if (cancelRequested) {
+            return;
+        }
+        
+        // Past the deadline, the tile is left for the next call. The first tile always runs so every call makes progress.
+        if (anyStarted.exchange(true) && std::chrono::high_resolution_clock::now() >= deadline) {
+            return;
+        }
+        
+        Walnut::Timer timer;
+        Utils::traceCounters = Utils::TraceCounters();
+        
+        uint32_t firstX, firstY, lastX, lastY;
+        tileBounds(tileIndex, firstX, firstY, lastX, lastY);
+        
+        uint32_t tileSamples = (lastX - firstX) * (lastY - firstY);
+        
+        if (interleaveScale > 1) {
+            // Interleaved pixels are too far apart to share packets
+            uint32_t startX = Utils::FirstInterleaved(firstX, interleaveX, interleaveScale);
+            uint32_t startY = Utils::FirstInterleaved(firstY, interleaveY, interleaveScale);
+            
+            tileSamples = 0;
+            
+            for (uint32_t y = startY; y < lastY; y += interleaveScale) {
+                for (uint32_t x = startX; x < lastX; x += interleaveScale) {
+                    AccumulatePixel(x, y, PerPixel(x, y));
+                    tileSamples += 1;
+                }
+            }
+        } else if (activeSettings.packetTracing) {
+            for (uint32_t y = firstY; y < lastY; y += RayPacket::TileSize) {
+                for (uint32_t x = firstX; x < lastX; x += RayPacket::TileSize) {
+                    PerPacket(x / RayPacket::TileSize, y / RayPacket::TileSize);
+                }
+            }
+        } else {
+            for (uint32_t y = firstY; y < lastY; y += 1) {
+                for (uint32_t x = firstX; x < lastX; x += 1) {
+                    AccumulatePixel(x, y, PerPixel(x, y));
+                }
+            }
+        }
+        
+        raysTraced += Utils::traceCounters.raysTraced;
+        nodesVisited += Utils::traceCounters.nodesVisited;
+        samples += tileSamples;
+        
+        statistics.tileTimes[tileIndex] = timer.ElapsedMillis();
+        tileFinished[tileIndex] = 1;
     });
-#else
-    for (uint32_t y = 0; y < finalImage->GetHeight(); y++) {
-        for (uint32_t x = 0; x < finalImage->GetWidth(); x++) {
-            glm::vec4 color = PerPixel(x, y);
-            accumulationData[(y * finalImage->GetWidth()) + x] += color;
+    
+    pendingTiles.erase(std::remove_if(pendingTiles.begin(), pendingTiles.end(), [this](uint32_t tileIndex) {
+        return tileFinished[tileIndex] != 0;
+    }), pendingTiles.end());
+    
+    return pendingTiles.empty();
+}
+
+bool Renderer::IsTileConverged(uint32_t firstX, uint32_t firstY, uint32_t lastX, uint32_t lastY) const {
+    float minSamples = static_cast<float>(std::max(activeSettings.adaptiveMinSamples, 2u));
+    float threshold = activeSettings.convergenceThreshold;
+    
+    for (uint32_t y = firstY; y < lastY; y += 1) {
+        for (uint32_t x = firstX; x < lastX; x += 1) {
+            uint32_t index = x + y * imageWidth;
+            
+            float count = accumulationData[index].a;
+            
+            if (count < minSamples) {
+                return false;
+            }
             
-            glm::vec4 accumulatedColor = accumulationData[(y * finalImage->GetWidth()) + x];
-            accumulatedColor /= static_cast<float>(frameIndex);
+            float mean = Utils::Luminance(glm::vec3(accumulationData[index])) / count;
+            float variance = glm::max(luminanceSquares[index] / count - mean * mean, 0.0f);
             
-            accumulatedColor = glm::clamp(accumulatedColor, glm::vec4(0.0f), glm::vec4(1.0f));
+            // The standard error, sqrt(variance / count), against the threshold without the square root
+            if (variance > threshold * threshold * count) {
+                return false;
+            }
+        }
+    }
+    
+    return true;
+}
 
-            imageData[(y * finalImage->GetWidth()) + x] = Utils::ConvertToRGBA(accumulatedColor);
+void Renderer::ResolveImage(const glm::vec4* accumulation, bool heatmap) {
+    float maxCount = 1.0f;
+    
+    if (heatmap) {
+        for (uint32_t index = 0; index < imageWidth * imageHeight; index += 1) {
+            maxCount = glm::max(maxCount, accumulation[index].a);
         }
     }
-#endif
+    
+    scheduler.Run(imageHeight, [this, accumulation, heatmap, maxCount](uint32_t y, uint32_t) {
+        for (uint32_t x = 0; x < imageWidth; x += 1) {
+            uint32_t index = x + y * imageWidth;
+            const glm::vec4& accumulated = accumulation[index];
+            
+            glm::vec4 color;
+            
+            if (heatmap) {
+                float t = accumulated.a / maxCount;
+                color = glm::vec4(t, 1.0f - glm::abs(2.0f * t - 1.0f), 1.0f - t, 1.0f);
+            } else {
+                color = accumulated / glm::max(accumulated.a, 1.0f);
+            }
+            
+            finalImage.pixels[index] = Utils::ConvertToRGBA(glm::clamp(color, glm::vec4(0.0f), glm::vec4(1.0f)));
+        }
+    });
+}
 
-    finalImage->SetData(imageData);
+void Renderer::DenoiseImage(const glm::vec4* accumulation, const float* squares) {
+    Denoiser::Input input;
+    input.width = imageWidth;
+    input.height = imageHeight;
+    input.accumulation = accumulation;
+    input.luminanceSquares = squares;
+    input.albedo = albedoAOV.data();
+    input.normals = normalAOV.data();
+    input.depths = depthAOV.data();
     
-    if (settings.accumulate) {
-        frameIndex += 1;
-    } else {
-        frameIndex = 1;
+    denoiser.Denoise(input, activeSettings.denoiseIterations, scheduler);
+    
+    const std::vector<glm::vec3>& output = denoiser.GetOutput();
+    
+    scheduler.Run(imageHeight, [this, &output](uint32_t y, uint32_t) {
+        for (uint32_t x = 0; x < imageWidth; x += 1) {
+            uint32_t index = x + y * imageWidth;
+            finalImage.pixels[index] = Utils::ConvertToRGBA(glm::clamp(glm::vec4(output[index], 1.0f), glm::vec4(0.0f), glm::vec4(1.0f)));
+        }
+    });
+}
+
+void Renderer::UpsampleInterleaved() {
+    size_t pixelCount = static_cast<size_t>(imageWidth) * imageHeight;
+    
+    upsampledAccumulation.resize(pixelCount);
+    upsampledSquares.resize(pixelCount);
+    
+    uint32_t scale = interleaveScale;
+    uint32_t columns = Utils::InterleavedCount(imageWidth, interleaveX, scale);
+    uint32_t rows = Utils::InterleavedCount(imageHeight, interleaveY, scale);
+    
+    scheduler.Run(imageHeight, [this, scale, columns, rows](uint32_t y, uint32_t) {
+        for (uint32_t x = 0; x < imageWidth; x += 1) {
+            uint32_t index = x + y * imageWidth;
+            const glm::vec4& accumulated = accumulationData[index];
+            
+            // Rendered pixels and reprojected ones show their own samples
+            upsampledAccumulation[index] = accumulated;
+            upsampledSquares[index] = luminanceSquares[index];
+            
+            if (accumulated.a > 0.0f || columns == 0 || rows == 0) {
+                continue;
+            }
+            
+            // Bilinear between the four rendered pixels around this one, on the grid of rendered pixels, clamped to
+            // the outermost ones
+            float gridX = glm::clamp((static_cast<float>(x) - static_cast<float>(interleaveX)) / static_cast<float>(scale), 0.0f, static_cast<float>(columns - 1));
+            float gridY = glm::clamp((static_cast<float>(y) - static_cast<float>(interleaveY)) / static_cast<float>(scale), 0.0f, static_cast<float>(rows - 1));
+            
+            uint32_t firstColumn = static_cast<uint32_t>(gridX);
+            uint32_t firstRow = static_cast<uint32_t>(gridY);
+            float fractionX = gridX - static_cast<float>(firstColumn);
+            float fractionY = gridY - static_cast<float>(firstRow);
+            
+            glm::vec3 mean(0.0f);
+            float weights = 0.0f;
+            
+            for (int tap = 0; tap < 4; tap += 1) {
+                uint32_t column = std::min(firstColumn + (tap & 1), columns - 1);
+                uint32_t row = std::min(firstRow + (tap >> 1), rows - 1);
+                
+                const glm::vec4& sample = accumulationData[(interleaveX + column * scale) + (interleaveY + row * scale) * imageWidth];
+                
+                if (sample.a <= 0.0f) {
+                    continue;
+                }
+                
+                float weight = ((tap & 1) != 0 ? fractionX : 1.0f - fractionX) * ((tap >> 1) != 0 ? fractionY : 1.0f - fractionY);
+                
+                mean += weight * glm::vec3(sample) / sample.a;
+                weights += weight;
+            }
+            
+            if (weights <= 0.0f) {
+                continue;
+            }
+            
+            // A single sample, so the denoiser estimates its variance from the neighbourhood
+            mean /= weights;
+            
+            float luminance = Utils::Luminance(mean);
+            
+            upsampledAccumulation[index] = glm::vec4(mean, 1.0f);
+            upsampledSquares[index] = luminance * luminance;
+        }
+    });
+}
+
+void Renderer::UpdateInterleaveScale(float passTime, float renderTime) {
+    float target = activeSettings.targetFrameTime;
+    
+    if (passTime > target) {
+        interactiveScale = std::min(interactiveScale + 1, Utils::MaxInterleaveScale);
+        return;
     }
+    
+    // Rendering costs about the same per pixel, so with a smaller block it would take (scale / (scale - 1))^2 as
+    // long. The rest of the pass, reprojection, upsampling and the resolve or denoiser, runs over every pixel at any
+    // scale, so it stays as it is.
+    if (interactiveScale > 1) {
+        float fixedTime = glm::max(passTime - renderTime, 0.0f);
+        float ratio = static_cast<float>(interactiveScale) / static_cast<float>(interactiveScale - 1);
+        
+        if (fixedTime + renderTime * ratio * ratio < target) {
+            interactiveScale -= 1;
+        }
+    }
+}
+
+void Renderer::ReprojectHistory() {
+    size_t pixelCount = static_cast<size_t>(imageWidth) * imageHeight;
+    
+    historyAccumulation.assign(accumulationData, accumulationData + pixelCount);
+    historyLuminanceSquares = luminanceSquares;
+    historyNormals = normalAOV;
+    historyDepths = depthAOV;
+    
+    float maxHistory = static_cast<float>(glm::max(activeSettings.reprojectionHistory, 1u));
+    
+    scheduler.Run(imageHeight, [this, maxHistory](uint32_t y, uint32_t) {
+        for (uint32_t x = 0; x < imageWidth; x += 1) {
+            uint32_t index = x + y * imageWidth;
+            
+            // The new first hit, which the pass would have found anyway, also fills the AOVs for the new camera
+            Ray ray;
+            ray.origin = activeCamera->GetPosition();
+            ray.direction = activeCamera->GetRayDirection(x, y);
+            
+            HitPayload payload = TraceRay(ray);
+            WriteAOVs(index, payload);
+            
+            bool hit = payload.hitDistance >= 0.0f;
+            
+            // Where the history camera saw the hit. Camera rays that hit nothing see the sky at infinity, which only
+            // the camera's rotation moves.
+            glm::vec4 clip = hit ? historyViewProjection * glm::vec4(payload.worldPosition, 1.0f) : historyViewProjection * glm::vec4(ray.direction, 0.0f);
+            
+            accumulationData[index] = glm::vec4(0.0f);
+            luminanceSquares[index] = 0.0f;
+            
+            if (clip.w <= 0.0f) {
+                continue;
+            }
+            
+            // Pixel coordinates follow GetRayDirection, where pixel (x, y) is at the corner of its footprint
+            float historyX = (clip.x / clip.w + 1.0f) * 0.5f * static_cast<float>(imageWidth);
+            float historyY = (clip.y / clip.w + 1.0f) * 0.5f * static_cast<float>(imageHeight);
+            
+            if (!(historyX > -1.0f && historyY > -1.0f && historyX < static_cast<float>(imageWidth) && historyY < static_cast<float>(imageHeight))) {
+                continue;
+            }
+            
+            int firstX = static_cast<int>(std::floor(historyX));
+            int firstY = static_cast<int>(std::floor(historyY));
+            float fractionX = historyX - static_cast<float>(firstX);
+            float fractionY = historyY - static_cast<float>(firstY);
+            
+            float expectedDepth = hit ? glm::distance(payload.worldPosition, historyPosition) : 0.0f;
+            
+            // Bilinear over the four history pixels around the point, leaving out the ones that saw another surface.
+            // Pixels have their own sample counts, so their means are blended and then given the blended count.
+            glm::vec3 mean(0.0f);
+            float squaresMean = 0.0f;
+            float count = 0.0f;
+            float weights = 0.0f;
+            
+            for (int tap = 0; tap < 4; tap += 1) {
+                int tapX = firstX + (tap & 1);
+                int tapY = firstY + (tap >> 1);
+                
+                if (tapX < 0 || tapY < 0 || tapX >= static_cast<int>(imageWidth) || tapY >= static_cast<int>(imageHeight)) {
+                    continue;
+                }
+                
+                uint32_t historyIndex = static_cast<uint32_t>(tapX) + static_cast<uint32_t>(tapY) * imageWidth;
+                const glm::vec4& accumulated = historyAccumulation[historyIndex];
+                float depth = historyDepths[historyIndex];
+                
+                if (accumulated.a <= 0.0f || hit != (depth > 0.0f)) {
+                    continue;
+                }
+                
+                if (hit) {
+                    if (glm::abs(depth - expectedDepth) > Utils::ReprojectionDepthTolerance * expectedDepth) {
+                        continue;
+                    }
+                    
+                    if (glm::dot(historyNormals[historyIndex], payload.worldNormal) < Utils::ReprojectionNormalTolerance) {
+                        continue;
+                    }
+                }
+                
+                float weight = ((tap & 1) != 0 ? fractionX : 1.0f - fractionX) * ((tap >> 1) != 0 ? fractionY : 1.0f - fractionY);
+                
+                mean += weight * glm::vec3(accumulated) / accumulated.a;
+                squaresMean += weight * historyLuminanceSquares[historyIndex] / accumulated.a;
+                count += weight * accumulated.a;
+                weights += weight;
+            }
+            
+            if (weights < 1e-3f) {
+                continue;
+            }
+            
+            // Whole samples, so the pixel's sampler carries on from a sample index of its own
+            count = glm::clamp(std::round(count / weights), 1.0f, maxHistory);
+            
+            accumulationData[index] = glm::vec4(mean / weights * count, count);
+            luminanceSquares[index] = squaresMean / weights * count;
+        }
+    });
+    
+    // Past the first pass, so the carried-over samples are not cleared
+    frameIndex = 2;
+    pendingTiles.clear();
+}
+
+void Renderer::RenderWavefront(std::atomic<uint64_t>& raysTraced, std::atomic<uint64_t>& nodesVisited) {
+    uint32_t width = imageWidth;
+    uint32_t pixelCount = width * imageHeight;
+    
+    // Paths are indexed by pixel, but only the pixels of an interleaved pass are queued
+    uint32_t columns = Utils::InterleavedCount(width, interleaveX, interleaveScale);
+    uint32_t rows = Utils::InterleavedCount(imageHeight, interleaveY, interleaveScale);
+    
+    wavefrontPaths.resize(pixelCount);
+    wavefrontKeys.resize(pixelCount);
+    wavefrontQueue.resize(columns * rows);
+    
+    // Runs body(first, last) over the live queue in fixed-size batches, folding the trace counters once per batch
+    auto forEachBatch = [this, &raysTraced, &nodesVisited](auto body) {
+        uint32_t count = static_cast<uint32_t>(wavefrontQueue.size());
+        
+        uint32_t batchCount = (count + Utils::WavefrontBatchSize - 1) / Utils::WavefrontBatchSize;
+        
+        scheduler.Run(batchCount, [&](uint32_t batch, uint32_t) {
+            if (cancelRequested) {
+                return;
+            }
+            
+            Utils::traceCounters = Utils::TraceCounters();
+            
+            uint32_t first = batch * Utils::WavefrontBatchSize;
+            uint32_t last = std::min(first + Utils::WavefrontBatchSize, count);
+            
+            body(first, last);
+            
+            raysTraced += Utils::traceCounters.raysTraced;
+            nodesVisited += Utils::traceCounters.nodesVisited;
+        });
+    };
+    
+    // Generate: one path per pixel, starting with its camera ray
+    scheduler.Run(rows, [this, width, columns](uint32_t row, uint32_t) {
+        uint32_t y = interleaveY + row * interleaveScale;
+        
+        for (uint32_t column = 0; column < columns; column += 1) {
+            uint32_t x = interleaveX + column * interleaveScale;
+            uint32_t index = x + y * width;
+            
+            WavefrontPath& path = wavefrontPaths[index];
+            path.ray.origin = activeCamera->GetPosition();
+            path.ray.direction = activeCamera->GetRayDirection(x, y);
+            path.state = PathState();
+            path.sampler = MakeSampler(x, y);
+            path.active = true;
+            
+            wavefrontQueue[column + row * columns] = index;
+        }
+    });
+    
+    // Ray origins are binned into Morton cells of the scene bounds, so nearby origins sort next to each other
+    glm::vec3 sceneMin(0.0f);
+    glm::vec3 sceneExtent(1.0f);
+    
+    if (!bvh.IsEmpty()) {
+        const BVH::Node& root = bvh.GetNodes()[0];
+        
+        sceneMin = root.boundsMin;
+        sceneExtent = glm::max(root.boundsMax - root.boundsMin, glm::vec3(std::numeric_limits<float>::epsilon()));
+    }
+    
+    auto byKey = [this](uint32_t lhs, uint32_t rhs) { return wavefrontKeys[lhs] < wavefrontKeys[rhs]; };
+    
+    for (int bounce = 0; bounce < activeSettings.maxBounces && !wavefrontQueue.empty() && !cancelRequested; bounce++) {
+        // Sort: camera rays are already coherent in scanline order. Bounced rays are grouped by direction octant,
+        // then by origin cell, so neighbouring rays in the queue walk similar parts of the tree.
+        if (bounce > 0) {
+            forEachBatch([&](uint32_t first, uint32_t last) {
+                for (uint32_t index = first; index < last; index += 1) {
+                    uint32_t pathIndex = wavefrontQueue[index];
+                    const Ray& ray = wavefrontPaths[pathIndex].ray;
+                    
+                    uint64_t octant = (ray.direction.x < 0.0f ? 1 : 0) | (ray.direction.y < 0.0f ? 2 : 0) | (ray.direction.z < 0.0f ? 4 : 0);
+                    uint64_t cell = Morton::Encode((ray.origin - sceneMin) / sceneExtent);
+                    
+                    wavefrontKeys[pathIndex] = (octant << 30) | cell;
+                }
+            });
+            
+            Utils::ParallelSort(scheduler, wavefrontQueue, byKey);
+        }
+        
+        // Intersect
+        forEachBatch([this](uint32_t first, uint32_t last) {
+            for (uint32_t index = first; index < last; index += 1) {
+                WavefrontPath& path = wavefrontPaths[wavefrontQueue[index]];
+                path.hitDistance = std::numeric_limits<float>::max();
+                path.objectIndex = -1;
+                
+                IntersectScene(path.ray, path.hitDistance, path.objectIndex);
+            }
+        });
+        
+        // Group by material, misses first, so each shading batch mostly reads the same material
+        forEachBatch([this](uint32_t first, uint32_t last) {
+            for (uint32_t index = first; index < last; index += 1) {
+                uint32_t pathIndex = wavefrontQueue[index];
+                const WavefrontPath& path = wavefrontPaths[pathIndex];
+                
+                wavefrontKeys[pathIndex] = path.objectIndex == -1 ? 0 : activeScene->spheres[path.objectIndex].materialIndex + 1;
+            }
+        });
+        
+        Utils::ParallelSort(scheduler, wavefrontQueue, byKey);
+        
+        // Shade
+        forEachBatch([this, bounce](uint32_t first, uint32_t last) {
+            for (uint32_t index = first; index < last; index += 1) {
+                WavefrontPath& path = wavefrontPaths[wavefrontQueue[index]];
+                
+                HitPayload payload = path.objectIndex == -1 ? Miss(path.ray) : ClosestHit(path.ray, path.hitDistance, path.objectIndex);
+                
+                if (bounce == 0) {
+                    WriteAOVs(wavefrontQueue[index], payload);
+                }
+                
+                path.active = Shade(path.ray, payload, path.state, path.sampler, bounce);
+            }
+        });
+        
+        wavefrontQueue.erase(std::remove_if(wavefrontQueue.begin(), wavefrontQueue.end(), [this](uint32_t pathIndex) {
+            return !wavefrontPaths[pathIndex].active;
+        }), wavefrontQueue.end());
+    }
+    
+    // A cancelled pass leaves unfinished paths, which must not be accumulated into samples that are carried over
+    if (cancelRequested) {
+        return;
+    }
+    
+    scheduler.Run(rows, [this, width, columns](uint32_t row, uint32_t) {
+        uint32_t y = interleaveY + row * interleaveScale;
+        
+        for (uint32_t column = 0; column < columns; column += 1) {
+            uint32_t x = interleaveX + column * interleaveScale;
+            AccumulatePixel(x, y, glm::vec4(wavefrontPaths[x + y * width].state.color, 1.0f));
+        }
+    });
+}
+
+void Renderer::UpdateAccelerationStructure(const Scene& scene) {
+    // A finished background rebuild replaces the refitted tree, as long as it was built from the same spheres
+    if (pendingBuild.valid() && pendingBuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        BVH rebuilt = pendingBuild.get();
+        
+        if (rebuilt.GetPrimitiveCount() == scene.spheres.size()) {
+            bvh = std::move(rebuilt);
+            
+            // Spheres may have kept moving while the build was running
+            bvh.Refit(scene.spheres);
+            wideBVH.Build(bvh);
+            sphereSoA.Build(scene.spheres, bvh.GetPrimitiveIndices());
+            refitSpheres.clear();
+        }
+    }
+    
+    if (rebuildRequested || bvh.GetPrimitiveCount() != scene.spheres.size()) {
+        bvh.Build(scene.spheres, activeSettings.builder, &scheduler);
+        wideBVH.Build(bvh);
+        sphereSoA.Build(scene.spheres, bvh.GetPrimitiveIndices());
+        rebuildRequested = false;
+        refitSpheres.clear();
+        
+        return;
+    }
+    
+    if (!refitSpheres.empty()) {
+        bvh.Refit(scene.spheres, refitSpheres);
+        wideBVH.Refit(scene.spheres, refitSpheres);
+        sphereSoA.Update(scene.spheres, refitSpheres);
+        refitSpheres.clear();
+    }
+    
+    // The background rebuild overlaps rendering, which keeps every worker busy, so it builds serially on its own thread
+    if (!pendingBuild.valid() && bvh.GetQualityRatio() > activeSettings.rebuildThreshold) {
+        pendingBuild = std::async(std::launch::async, [spheres = scene.spheres, builder = activeSettings.builder]() {
+            BVH rebuilt;
+            rebuilt.Build(spheres, builder);
+            
+            return rebuilt;
+        });
+    }
+}
+
+void Renderer::AccumulatePixel(uint32_t x, uint32_t y, const glm::vec4& color) {
+    accumulationData[(y * imageWidth) + x] += color;
+    
+    float luminance = Utils::Luminance(glm::vec3(color));
+    luminanceSquares[(y * imageWidth) + x] += luminance * luminance;
+    
+    // Adaptive sampling leaves pixels with different sample counts, so each is divided by its own
+    glm::vec4 accumulatedColor = accumulationData[(y * imageWidth) + x];
+    accumulatedColor /= accumulatedColor.a;
+    
+    accumulatedColor = glm::clamp(accumulatedColor, glm::vec4(0.0f), glm::vec4(1.0f));
+
+    finalImage.pixels[(y * imageWidth) + x] = Utils::ConvertToRGBA(accumulatedColor);
+}
+
+void Renderer::WriteAOVs(uint32_t index, const HitPayload& payload) {
+    if (payload.hitDistance < 0.0f) {
+        albedoAOV[index] = glm::vec3(1.0f);
+        normalAOV[index] = glm::vec3(0.0f);
+        depthAOV[index] = 0.0f;
+        
+        return;
+    }
+    
+    const Sphere& sphere = activeScene->spheres[payload.objectIndex];
+    
+    albedoAOV[index] = activeScene->materials[sphere.materialIndex].albedo;
+    normalAOV[index] = payload.worldNormal;
+    depthAOV[index] = payload.hitDistance;
 }
 
 glm::vec4 Renderer::PerPixel(uint32_t x, uint32_t y) {
     Ray ray;
     ray.origin = activeCamera->GetPosition();
-    ray.direction = activeCamera->GetRayDirections()[x + y * finalImage->GetWidth()];
+    ray.direction = activeCamera->GetRayDirection(x, y);
     
-    int bounces = 5;
-    glm::vec3 color(0.0f);
-    float multiplier = 1.0f;
+    HitPayload payload = TraceRay(ray);
+    WriteAOVs(x + y * imageWidth, payload);
     
-    for (int bounce = 0; bounce < bounces; bounce++) {
-        Renderer::HitPayload payload = TraceRay(ray);
+    return TracePath(ray, payload, MakeSampler(x, y));
+}
+
+Sampler Renderer::MakeSampler(uint32_t x, uint32_t y) const {
+    // The pixel's own sample count, which only matches frameIndex - 1 without adaptive sampling
+    uint32_t sampleIndex = static_cast<uint32_t>(accumulationData[x + y * imageWidth].a);
+    
+    return Sampler(activeSettings.sampler, x, y, x + y * imageWidth, sampleIndex, activeSettings.seed);
+}
+
+void Renderer::PerPacket(uint32_t packetX, uint32_t packetY) {
+    uint32_t width = imageWidth;
+    uint32_t height = imageHeight;
+    
+    uint32_t firstX = packetX * RayPacket::TileSize;
+    uint32_t firstY = packetY * RayPacket::TileSize;
+    
+    RayPacket packet;
+    packet.origin = activeCamera->GetPosition();
+    
+    // Clamping repeats the last row or column for tiles hanging off the edge, which keeps the packet coherent
+    for (int index = 0; index < RayPacket::Size; index++) {
+        uint32_t x = std::min(firstX + index % RayPacket::TileSize, width - 1);
+        uint32_t y = std::min(firstY + index / RayPacket::TileSize, height - 1);
         
-        if (payload.hitDistance < 0.0f) {
-            glm::vec3 skyColor = glm::vec3(0.6f, 0.7f, 0.9f);
-            color += skyColor * multiplier;
-            
+        packet.SetDirection(index, activeCamera->GetRayDirection(x, y));
+    }
+    
+    packet.Finalize();
+    
+    HitPayload payloads[RayPacket::Size];
+    TracePacket(packet, payloads);
+    
+    for (int index = 0; index < RayPacket::Size; index++) {
+        uint32_t x = firstX + index % RayPacket::TileSize;
+        uint32_t y = firstY + index / RayPacket::TileSize;
+        
+        if (x >= width || y >= height) {
+            continue;
+        }
+        
+        Utils::traceCounters.raysTraced += 1;
+        
+        WriteAOVs(x + y * width, payloads[index]);
+        AccumulatePixel(x, y, TracePath(packet.GetRay(index), payloads[index], MakeSampler(x, y)));
+    }
+}
+
+glm::vec4 Renderer::TracePath(Ray ray, HitPayload payload, Sampler sampler) {
+    PathState path;
+    
+    for (int bounce = 0; bounce < activeSettings.maxBounces; bounce++) {
+        // The primary hit was traced by the caller
+        if (bounce > 0) {
+            payload = TraceRay(ray);
+        }
+        
+        if (!Shade(ray, payload, path, sampler, bounce)) {
             break;
         }
+    }
+    
+    return glm::vec4(path.color, 1.0f); // RGBA
+}
+
+bool Renderer::Shade(Ray& ray, const HitPayload& payload, PathState& path, Sampler& sampler, int bounce) {
+    const EnvironmentMap* environment = activeScene->environment.get();
+    
+    if (payload.hitDistance < 0.0f) {
+        // The bounce ray found the light. Camera rays always count, since no light sample could have found it.
+        if (environment != nullptr) {
+            glm::vec3 radiance = environment->Radiance(ray.direction) * activeSettings.environmentIntensity;
+            path.color += radiance * BounceLightWeight(path.brdfPdf, environment->Pdf(ray.direction)) * path.throughput;
+            
+            return false;
+        }
         
-        glm::vec3 lightDirection = glm::normalize(this->lightDirection);
+        glm::vec3 skyColor = glm::vec3(0.6f, 0.7f, 0.9f);
+        path.color += skyColor * path.throughput;
         
-        float dot = glm::dot(payload.worldNormal, -lightDirection); // == cos(angle) because both parameters are unit vectors
-        float intensity = glm::max(dot, 0.0f);
+        float lightPdf = activeLight.Pdf(ray.direction);
         
-        const Sphere& closestSphere = activeScene->spheres[payload.objectIndex];
-        const Material& material = activeScene->materials[closestSphere.materialIndex];
+        if (lightPdf > 0.0f) {
+            path.color += activeLight.Radiance(ray.direction) * BounceLightWeight(path.brdfPdf, lightPdf) * path.throughput;
+        }
         
-        glm::vec3 sphereColor = material.albedo;
-        sphereColor *= intensity;
+        return false;
+    }
+    
+    const Sphere& closestSphere = activeScene->spheres[payload.objectIndex];
+    const Material& material = activeScene->materials[closestSphere.materialIndex];
+    
+    // The ray hit an emissive sphere, which light sampling from the surface the ray left could also have picked
+    glm::vec3 emission = material.GetEmission();
+    
+    if (emission.r > 0.0f || emission.g > 0.0f || emission.b > 0.0f) {
+        float lightPdf = path.brdfPdf > 0.0f ? lightBVH.Pdf(ray.origin, path.normal, static_cast<uint32_t>(payload.objectIndex)) : 0.0f;
+        path.color += emission * BounceLightWeight(path.brdfPdf, lightPdf) * path.throughput;
+    }
+    
+    glm::vec3 origin = payload.worldPosition + payload.worldNormal * 0.0001f;
+    glm::vec3 view = -ray.direction;
+    
+    // Drawn whether or not it is used, so the BRDF sample takes the same dimensions in every mode
+    glm::vec3 lightRandom = sampler.Vec3(0.0f, 1.0f);
+    
+    // Next-event estimation: a direction toward a light is sampled, and only counts when nothing blocks it. The
+    // distant light, the sun or the environment, is sampled at every hit, and so is one emissive sphere, picked by
+    // the light hierarchy in proportion to its estimated contribution.
+    if (activeSettings.lightSampling != LightSampling::BRDF) {
+        LightSample lightSample;
+        bool deltaLight = false;
+        
+        if (environment != nullptr) {
+            lightSample = environment->SampleDirection(glm::vec2(lightRandom.x, lightRandom.y));
+            lightSample.irradiance *= activeSettings.environmentIntensity;
+        } else {
+            lightSample = activeLight.SampleDirection(glm::vec2(lightRandom.x, lightRandom.y));
+            deltaLight = activeLight.IsDelta();
+        }
+        
+        path.color += DirectLight(lightSample, deltaLight, material, payload, origin, view) * path.throughput;
+    }
+    
+    if (!lightBVH.IsEmpty()) {
+        glm::vec3 emitterRandom = sampler.Vec3(0.0f, 1.0f);
         
-        color += sphereColor * multiplier;
+        const SphereLight* light;
+        float probability;
+        
+        if (activeSettings.lightSampling != LightSampling::BRDF && lightBVH.Sample(origin, payload.worldNormal, lightRandom.z, light, probability)) {
+            LightSample lightSample = light->SampleDirection(origin, glm::vec2(emitterRandom.x, emitterRandom.y));
+            lightSample.pdf *= probability;
+            lightSample.irradiance /= probability;
+            
+            // The shadow ray stops short of the light's own surface
+            lightSample.distance *= 0.9999f;
+            
+            path.color += DirectLight(lightSample, false, material, payload, origin, view) * path.throughput;
+        }
+    }
+    
+    BRDF::Sample sample;
+    
+    if (!BRDF::SampleDirection(material, payload.worldNormal, view, sampler.Vec3(0.0f, 1.0f), sample)) {
+        return false;
+    }
+    
+    path.throughput *= sample.weight;
+    path.brdfPdf = sample.pdf;
+    path.normal = payload.worldNormal;
+    
+    ray.origin = origin;
+    ray.direction = sample.direction;
+    
+    // Russian roulette. The throughput is the most the rest of the path can still add, so its largest channel
+    // doubles as the chance of going on, and survivors are weighted up by the same factor to keep the expected
+    // color unchanged.
+    if (bounce + 1 >= activeSettings.minBounces) {
+        float survival = glm::min(glm::max(path.throughput.r, glm::max(path.throughput.g, path.throughput.b)), 1.0f);
         
-        multiplier *= 0.5f;
+        if (sampler.Next() >= survival) {
+            return false;
+        }
         
-        ray.origin = payload.worldPosition + payload.worldNormal * 0.0001f;
-        ray.direction = glm::reflect(ray.direction, payload.worldNormal + material.roughness
-                                      * Walnut::Random::Vec3(-0.5f, 0.5f));
+        path.throughput /= survival;
+    }
+    
+    return true;
+}
+
+glm::vec3 Renderer::DirectLight(const LightSample& lightSample, bool deltaLight, const Material& material, const HitPayload& payload, const glm::vec3& origin, const glm::vec3& view) {
+    if (lightSample.pdf <= 0.0f || glm::dot(payload.worldNormal, lightSample.direction) <= 0.0f) {
+        return glm::vec3(0.0f);
+    }
+    
+    float pdf;
+    glm::vec3 reflectance = BRDF::Evaluate(material, payload.worldNormal, view, lightSample.direction, pdf);
+    
+    // A delta light cannot be hit by a bounce ray, so light sampling gets its full weight
+    float weight = 1.0f;
+    
+    if (activeSettings.lightSampling == LightSampling::MultipleImportance && !deltaLight) {
+        weight = Utils::PowerHeuristic(lightSample.pdf, pdf);
+    }
+    
+    if (weight <= 0.0f) {
+        return glm::vec3(0.0f);
+    }
+    
+    Ray shadowRay;
+    shadowRay.origin = origin;
+    shadowRay.direction = lightSample.direction;
+    
+    if (activeSettings.shadowRays && IsOccluded(shadowRay, lightSample.distance)) {
+        return glm::vec3(0.0f);
     }
     
-    return glm::vec4(color, 1.0f); // RGBA
+    return reflectance * lightSample.irradiance * weight;
+}
+
+float Renderer::BounceLightWeight(float brdfPdf, float lightPdf) const {
+    // Camera rays, and lights that light sampling cannot pick in this direction, leave the bounce ray alone
+    if (brdfPdf == 0.0f || lightPdf == 0.0f) {
+        return 1.0f;
+    }
+    
+    switch (activeSettings.lightSampling) {
+        case LightSampling::BRDF:
+            return 1.0f;
+        case LightSampling::Light:
+            return 0.0f;
+        case LightSampling::MultipleImportance:
+            return Utils::PowerHeuristic(brdfPdf, lightPdf);
+    }
+    
+    return 1.0f;
+}
+
+void Renderer::TracePacket(const RayPacket& packet, HitPayload* payloads) {
+    float hitDistances[RayPacket::Size];
+    int closestSpheres[RayPacket::Size];
+    
+    for (int index = 0; index < RayPacket::Size; index++) {
+        hitDistances[index] = std::numeric_limits<float>::max();
+        closestSpheres[index] = -1;
+    }
+    
+    uint32_t nodesVisited = 0;
+    
+    // The wide tree has no packet traversal, so packets always walk the binary tree it was collapsed from
+    if (activeSettings.acceleration == Acceleration::None) {
+        sphereSoA.IntersectPacket(packet, 0, 0, sphereSoA.GetCount(), hitDistances, closestSpheres);
+    } else {
+        bvh.IntersectPacket(packet, sphereSoA, hitDistances, closestSpheres, nodesVisited);
+    }
+    
+    Utils::traceCounters.nodesVisited += nodesVisited;
+    
+    for (int index = 0; index < RayPacket::Size; index++) {
+        if (closestSpheres[index] == -1) {
+            payloads[index] = Miss(packet.GetRay(index));
+        } else {
+            payloads[index] = ClosestHit(packet.GetRay(index), hitDistances[index], closestSpheres[index]);
+        }
+    }
 }
 
 Renderer::HitPayload Renderer::ClosestHit(const Ray& ray, float hitDistance, int objectIndex) {
@@ -175,49 +1420,7 @@ Renderer::HitPayload Renderer::TraceRay(const Ray& ray) {
     int closestSphere = -1;
     float hitDistance = std::numeric_limits<float>::max();
     
-    for (size_t sphereIndex = 0; sphereIndex < activeScene->spheres.size(); sphereIndex++) {
-        const Sphere& sphere = activeScene->spheres[sphereIndex];
-        
-        // (bx^2 + by^2 + bz^2)t^2 + (2(axbx + ayby + azbz))t + (ax^2 + ay^2 + az^2 - r^2) = 0]
-        // where
-        // a = ray origin
-        // b = ray direction
-        // r = radius
-        // t = hit distance
-
-        // NOTE: a, b, & c are the quadratic variables, not the ones mentioned above. These are the coefficients above
-
-        glm::vec3 origin = ray.origin - sphere.position;
-        
-        // float a = rayDirection.x * rayDirection.x + rayDirection.y * rayDirection.y + rayDirection.z * rayDirection.z;
-        float a = glm::dot(ray.direction, ray.direction);
-
-        // float b = 2.0f * (rayOrigin.x * rayDirection.x + rayOrigin.y * rayDirection.y + rayOrigin.z * rayDirection.z);
-        float b = 2.0f * glm::dot(origin, ray.direction);
-
-        // float c = rayOrigin.x * rayOrigin.x + rayOrigin.y * rayOrigin.y * rayOrigin.z * rayOrigin.z - radius * radius;
-        float c = glm::dot(origin, origin) - sphere.radius * sphere.radius;
-
-        // Quadratic formula discriminant
-        // b^2 - 4ac
-        float discriminant = b * b - 4.0f * a * c;
-
-        // No hit, so go to the next sphere
-        if (discriminant < 0.0f) {
-            continue;
-        }
-        
-        // Full quadratic equation
-        // (-b +- sqrt(discriminant)) / (2.0f * a)
-        // float t0 = (-b + glm::sqrt(discriminant)) / (2.0f * a);
-        // float t1 = (-b - glm::sqrt(discriminant)) / (2.0f * a);
-        float closestT = (-b - glm::sqrt(discriminant)) / (2.0f * a);
-        
-        if (closestT > 0.0f && closestT < hitDistance) {
-            closestSphere = static_cast<uint32_t>(sphereIndex);
-            hitDistance = closestT;
-        }
-    }
+    IntersectScene(ray, hitDistance, closestSphere);
     
     if (closestSphere == -1) {
         return Miss(ray);
@@ -225,3 +1428,44 @@ Renderer::HitPayload Renderer::TraceRay(const Ray& ray) {
         return ClosestHit(ray, hitDistance, closestSphere);
     }
 }
+
+bool Renderer::IsOccluded(const Ray& ray, float maxDistance) {
+    uint32_t nodesVisited = 0;
+    bool occluded = false;
+    
+    switch (activeSettings.acceleration) {
+        case Acceleration::None:
+            occluded = sphereSoA.Occluded(ray, 0, sphereSoA.GetCount(), maxDistance);
+            break;
+        case Acceleration::BVH:
+            occluded = bvh.Occluded(ray, sphereSoA, maxDistance, nodesVisited);
+            break;
+        case Acceleration::WideBVH:
+            occluded = wideBVH.Occluded(ray, sphereSoA, maxDistance, nodesVisited);
+            break;
+    }
+    
+    Utils::traceCounters.raysTraced += 1;
+    Utils::traceCounters.nodesVisited += nodesVisited;
+    
+    return occluded;
+}
+
+void Renderer::IntersectScene(const Ray& ray, float& hitDistance, int& objectIndex) {
+    uint32_t nodesVisited = 0;
+    
+    switch (activeSettings.acceleration) {
+        case Acceleration::None:
+            sphereSoA.Intersect(ray, 0, sphereSoA.GetCount(), hitDistance, objectIndex);
+            break;
+        case Acceleration::BVH:
+            bvh.Intersect(ray, sphereSoA, hitDistance, objectIndex, nodesVisited);
+            break;
+        case Acceleration::WideBVH:
+            wideBVH.Intersect(ray, sphereSoA, hitDistance, objectIndex, nodesVisited);
+            break;
+    }
+    
+    Utils::traceCounters.raysTraced += 1;
+    Utils::traceCounters.nodesVisited += nodesVisited;
+}
@@ -7,43 +7,227 @@
 
 #pragma once
 
-#include <Walnut/Image.h>
-
 #include <glm/glm.hpp>
 
+#include "BRDF.h"
+#include "BVH.h"
 #include "Camera.h"
+#include "Denoiser.h"
+#include "Framebuffer.h"
+#include "Light.h"
+#include "LightBVH.h"
 #include "Ray.h"
+#include "Sampler.h"
 #include "Scene.h"
+#include "SphereSoA.h"
+#include "TileScheduler.h"
+#include "WideBVH.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
 
 class Renderer {
 
 public:
     
+    enum class Acceleration {
+        None,   // Every sphere, 4 at a time with the SIMD kernel. Fastest for a handful of spheres
+        BVH,
+        WideBVH
+    };
+    
+    enum class Integrator {
+        PerPixel,   // Each pixel's whole path on one thread
+        Wavefront   // Every path's bounce N as one sorted stream: intersect all, then shade all
+    };
+    
+    // How the light reaching a surface is found
+    enum class LightSampling {
+        BRDF,              // Only by bounce rays that happen to hit the light
+        Light,             // Only by shadow rays toward points sampled on the light
+        MultipleImportance // Both, weighted by the power heuristic so each strategy covers where it is better
+    };
+    
     struct Settings {
         bool accumulate = true;
+        
+        Integrator integrator = Integrator::PerPixel;
+        
+        BVH::Builder builder = BVH::Builder::SAH;
+        
+        Acceleration acceleration = Acceleration::WideBVH;
+        
+        // Trace primary rays as 4x4 pixel packets through the binary BVH, then continue each path as a single ray.
+        // Only used by the per-pixel integrator.
+        bool packetTracing = true;
+        
+        // Edge length in pixels of the square tiles handed to the render threads, rounded up to a whole packet
+        uint32_t tileSize = 32;
+        
+        // Render threads, 0 for one per core
+        uint32_t workerCount = 0;
+        bool pinWorkers = false;
+        
+        // Refitted BVH cost, relative to a fresh build, above which a background rebuild is started
+        float rebuildThreshold = 1.5f;
+        
+        // Milliseconds a Render may spend, 0 for exactly one full pass. With a budget, a Render fits in as many
+        // passes as it can, and the tiles of a pass it could not finish are rendered first by the next Render.
+        float frameBudget = 0.0f;
+        
+        // Where the values for sampling bounce directions come from. Sobol and blue noise converge in fewer frames.
+        Sampler::Type sampler = Sampler::Type::Sobol;
+        uint32_t seed = 0;
+        
+        // Tests the light at every bounce with a shadow ray, so surfaces facing it are only lit when nothing is in
+        // the way
+        bool shadowRays = true;
+        
+        LightSampling lightSampling = LightSampling::MultipleImportance;
+        
+        // Angular diameter of the light in degrees, 0 for a point-like light only light sampling can find
+        float lightAngle = 1.0f;
+        
+        // Scales the radiance of the scene's environment map, when it has one
+        float environmentIntensity = 1.0f;
+        
+        // Every path takes at least minBounces bounces. Past that, Russian roulette ends it with a probability that
+        // grows as its throughput falls, up to a hard limit of maxBounces.
+        int minBounces = 3;
+        int maxBounces = 8;
+        
+        // Skips tiles whose pixels all have at least adaptiveMinSamples samples and a standard error of the mean
+        // luminance below convergenceThreshold. Only the per-pixel integrator renders by tiles, so only it adapts.
+        bool adaptiveSampling = false;
+        float convergenceThreshold = 0.005f;
+        uint32_t adaptiveMinSamples = 16;
+        
+        // Shows the samples of each pixel instead of its color, from blue for the fewest to red for the most
+        bool sampleHeatmap = false;
+        
+        // Shows the accumulation filtered by an edge-aware à-trous wavelet filter, guided by the albedo, normal and
+        // depth of each pixel's first hit. Every iteration doubles the reach of the filter.
+        bool denoise = false;
+        uint32_t denoiseIterations = 5;
+        
+        // Carries the accumulation over when the camera moves, by finding where each pixel's first hit was seen
+        // from the old camera. Pixels whose surface was hidden or off screen start over. Carried-over pixels keep at
+        // most reprojectionHistory samples, so lighting that depends on the view, like reflections, catches up.
+        bool reprojection = true;
+        uint32_t reprojectionHistory = 32;
+        
+        // While the camera moves, each pass renders one pixel of every block of pixels and fills in the rest of the
+        // block from its neighbours. After each such pass the block edge grows or shrinks by one, up to 4, to bring
+        // the pass within targetFrameTime milliseconds. Once the camera stops, passes are full resolution again.
+        bool dynamicResolution = true;
+        float targetFrameTime = 33.0f;
+    };
+    
+    struct Statistics {
+        uint64_t raysTraced = 0;
+        uint64_t nodesVisited = 0;
+        
+        // Milliseconds spent on each tile in the last per-pixel frame, row-major over the tile grid
+        std::vector<float> tileTimes;
+        uint32_t tileColumns = 0;
+        uint32_t tileRows = 0;
+        
+        TileScheduler::Statistics scheduler;
+        
+        // Pixel samples taken by the last Render, per second, and how far into its pass it got
+        uint64_t samples = 0;
+        float samplesPerSecond = 0.0f;
+        float passProgress = 1.0f;
+        uint32_t frameIndex = 1;
+        
+        // Share of the tiles adaptive sampling skipped in the last pass
+        float convergedFraction = 0.0f;
+        
+        BVH::Statistics accelerationStructure;
+        float accelerationQuality = 1.0f;
+        bool rebuildingAccelerationStructure = false;
+        
+        // Milliseconds the denoiser took in the last Render, 0 when it is off
+        float denoiseTime = 0.0f;
+        
+        // Edge of the blocks of pixels the last pass rendered one pixel of, 1 at full resolution
+        uint32_t renderScale = 1;
+        
+        float NodesPerRay() const { return raysTraced == 0 ? 0.0f : static_cast<float>(nodesVisited) / static_cast<float>(raysTraced); }
     };
     
 public:
 
     Renderer() = default;
+    ~Renderer();
 
     void OnResize(uint32_t width, uint32_t height);
     void Render(const Scene& scene, const Camera& camera);
 
-    std::shared_ptr<Walnut::Image> GetFinalImage() const { return finalImage; }
+    // The last rendered frame, or in asynchronous mode, the last presented one
+    const Framebuffer& GetFinalImage() const { return IsRenderThreadRunning() ? frames[presentFrame].image : finalImage; }
+    
+    // Starts a new accumulation. With the render thread running, this also cancels the pass in flight.
+    void ResetFrameIndex();
     
-    void ResetFrameIndex() { frameIndex = 1; }
+    // Starts a new accumulation, or with reprojection on, carries the current one over to the camera of the next
+    // pass. A reset requested along with it wins.
+    void OnCameraMoved();
+    
+    // Marks the acceleration structure as stale so it is rebuilt before the next render
+    void OnSceneChanged();
+    
+    // Records a sphere whose position or radius changed, so only its path to the root is refitted
+    void OnSphereChanged(uint32_t sphereIndex);
+    
+    // Marks the lights as stale after a material, or the material of a sphere, was edited
+    void OnMaterialChanged();
+    
+    // Asynchronous mode. The render thread runs passes back to back on its own copies of the scene and camera,
+    // finishing each one into a triple-buffered frame, while the UI thread only submits edits and presents.
+    // Render and OnResize must not be called while the render thread runs.
+    void StartRenderThread();
+    void StopRenderThread();
+    bool IsRenderThreadRunning() const { return renderThread.joinable(); }
+    
+    // Hands the render thread a new scene, camera and viewport size, cancelling the pass in flight
+    void Submit(const Scene& scene, const Camera& camera, uint32_t width, uint32_t height);
+    
+    // Called once per UI frame. Passes the current settings to the render thread and makes its newest finished
+    // frame the final image, returning false when no new frame was ready.
+    bool Present();
     
     Settings& GetSettings() { return settings; }
     
+    // Statistics of the last rendered frame, or in asynchronous mode, of the last presented one
+    const Statistics& GetStatistics() const { return IsRenderThreadRunning() ? frames[presentFrame].statistics : statistics; }
+    
+    // Only safe to use while the render thread is stopped
+    const BVH& GetAccelerationStructure() const { return bvh; }
+    
 public:
     
     glm::vec3 lightDirection { -1.0f, -1.0f, -1.0f };
 
 private:
     
+    // What a path carries from one bounce to the next
+    struct PathState {
+        glm::vec3 color { 0.0f };
+        glm::vec3 throughput { 1.0f };
+        
+        // Density the BRDF sampled the current ray with, 0 for camera rays, and the normal of the surface it left.
+        // Lights the ray hits are weighted against light sampling from that surface with both.
+        float brdfPdf = 0.0f;
+        glm::vec3 normal { 0.0f };
+    };
+    
     struct HitPayload {
         float hitDistance;
         glm::vec3 worldPosition;
@@ -53,23 +237,212 @@ private:
     };
 
     glm::vec4 PerPixel(uint32_t x, uint32_t y); // RayGen
+    void PerPacket(uint32_t packetX, uint32_t packetY); // RayGen for a packet tile, accumulating each of its pixels
+    glm::vec4 TracePath(Ray ray, HitPayload payload, Sampler sampler);
+    
+    // Adds the contribution of the given bounce to the path's color and sets up the next ray. Returns false when the
+    // path has ended, either at the sky or by Russian roulette.
+    bool Shade(Ray& ray, const HitPayload& payload, PathState& path, Sampler& sampler, int bounce);
+    
+    // Light arriving at the surface from a light sample, weighted against BRDF sampling, or nothing when the sample
+    // is below the surface or blocked
+    glm::vec3 DirectLight(const LightSample& lightSample, bool deltaLight, const Material& material, const HitPayload& payload, const glm::vec3& origin, const glm::vec3& view);
+    
+    // Weight of light found by a bounce ray that the BRDF sampled with brdfPdf, where light sampling would have
+    // picked the same direction with lightPdf
+    float BounceLightWeight(float brdfPdf, float lightPdf) const;
+    
+    // The sampler for pixel (x, y) in the pass being rendered
+    Sampler MakeSampler(uint32_t x, uint32_t y) const;
+    
+    // Renders the pending tiles of the current pass until the deadline. Returns true once the pass is complete.
+    // With adaptive sampling, a new pass only holds the tiles that have not converged.
+    bool RenderTiles(std::atomic<uint64_t>& raysTraced, std::atomic<uint64_t>& nodesVisited, std::atomic<uint64_t>& samples, std::chrono::high_resolution_clock::time_point deadline);
+    
+    bool IsTileConverged(uint32_t firstX, uint32_t firstY, uint32_t lastX, uint32_t lastY) const;
+    
+    // Writes every pixel of the final image from an accumulation, as its color or as the sample heatmap
+    void ResolveImage(const glm::vec4* accumulation, bool heatmap);
+    
+    // Writes every pixel of the final image from an accumulation and its luminance squares, denoised
+    void DenoiseImage(const glm::vec4* accumulation, const float* squares);
+    
+    // Fills the pixels an interleaved pass left without samples by blending the rendered pixels around them, into
+    // upsampledAccumulation and upsampledSquares
+    void UpsampleInterleaved();
+    
+    // Picks the block edge of the next interleaved pass from how long this one took, and how much of that went to
+    // rendering its pixels
+    void UpdateInterleaveScale(float passTime, float renderTime);
+    
+    // Warps the accumulation and the AOVs from the history camera to the active one
+    void ReprojectHistory();
+    
+    void RenderWavefront(std::atomic<uint64_t>& raysTraced, std::atomic<uint64_t>& nodesVisited);
+    
+    void AccumulatePixel(uint32_t x, uint32_t y, const glm::vec4& color);
+    
+    // Records the first hit of the pixel at index for the denoiser
+    void WriteAOVs(uint32_t index, const HitPayload& payload);
     
     HitPayload TraceRay(const Ray& ray);
+    void TracePacket(const RayPacket& packet, HitPayload* payloads);
+    void IntersectScene(const Ray& ray, float& hitDistance, int& objectIndex);
+    
+    // Any-hit query for shadow rays: whether anything lies along the ray closer than maxDistance. Stops at the first
+    // hit instead of looking for the closest, so it is cheaper than IntersectScene.
+    bool IsOccluded(const Ray& ray, float maxDistance);
     HitPayload ClosestHit(const Ray& ray, float hitDistance, int objectIndex);
     HitPayload Miss(const Ray& ray);
+    
+    void UpdateAccelerationStructure(const Scene& scene);
+    
+    void ResizeBuffers(uint32_t width, uint32_t height);
+    
+    // Renders one pass into imageData. Returns false when the pass was cancelled before it finished.
+    bool RenderPass(const Scene& scene, const Camera& camera);
+    
+    void RenderThreadLoop();
+    void TakeSceneEdits();
 
 private:
     const Scene* activeScene = nullptr;
     const Camera* activeCamera = nullptr;
 
-    std::shared_ptr<Walnut::Image> finalImage;
-    uint32_t* imageData = nullptr;
+    Framebuffer finalImage;
+    uint32_t imageWidth = 0;
+    uint32_t imageHeight = 0;
+    
+    // settings and lightDirection belong to the UI. Each pass renders with a copy taken when it starts.
     Settings settings;
+    Settings activeSettings;
+    glm::vec3 activeLightDirection;
+    DirectionalLight activeLight;
+    
+    // Emissive spheres of the active scene, rebuilt after any edit that can change them
+    LightBVH lightBVH;
+    
+    TileScheduler scheduler;
+    std::vector<uint32_t> tileOrder;
     
-    std::vector<uint32_t> imageHorizontalIterator;
-    std::vector<uint32_t> imageVerticalIterator;
+    // Tiles of the current pass still to be rendered, in tileOrder order. Finished tiles hold frameIndex samples,
+    // pending ones frameIndex - 1.
+    std::vector<uint32_t> pendingTiles;
+    std::vector<uint8_t> tileFinished;
     
+    // Sums of each pixel's samples. The alpha of every sample is 1, so alpha is the pixel's sample count.
     glm::vec4* accumulationData = nullptr;
     
+    // Sums of each pixel's squared sample luminance, for the variance estimates of adaptive sampling
+    std::vector<float> luminanceSquares;
+    
+    // Tiles adaptive sampling skipped in the current pass, and whether that was all of them
+    std::vector<uint8_t> tileConverged;
+    bool imageConverged = false;
+    
+    // First-hit albedo, normal and distance of every pixel, the distance 0 for camera rays that hit nothing
+    std::vector<glm::vec3> albedoAOV;
+    std::vector<glm::vec3> normalAOV;
+    std::vector<float> depthAOV;
+    
+    Denoiser denoiser;
+    
+    // Camera the accumulation and the AOVs were last rendered from, and whether they hold anything to reproject
+    glm::mat4 historyViewProjection { 1.0f };
+    glm::vec3 historyPosition { 0.0f };
+    bool historyValid = false;
+    
+    // Copies of the accumulation and the AOVs that reprojection reads from while it overwrites the originals
+    std::vector<glm::vec4> historyAccumulation;
+    std::vector<float> historyLuminanceSquares;
+    std::vector<glm::vec3> historyNormals;
+    std::vector<float> historyDepths;
+    
+    bool heatmapShown = false;
+    bool denoisedShown = false;
+    
+    // Pixels an interleaved pass renders: the one at (interleaveX, interleaveY) of every block of interleaveScale
+    // pixels square. interactiveScale is the block edge for passes while the camera moves, kept from one move to
+    // the next, and interleaveStep walks the offset through the block, so a moving camera still fills every pixel.
+    uint32_t interleaveScale = 1;
+    uint32_t interleaveX = 0;
+    uint32_t interleaveY = 0;
+    uint32_t interactiveScale = 1;
+    uint32_t interleaveStep = 0;
+    bool interleavedShown = false;
+    
+    std::vector<glm::vec4> upsampledAccumulation;
+    std::vector<float> upsampledSquares;
+    
     uint32_t frameIndex = 1;
+    
+    BVH bvh;
+    WideBVH wideBVH;
+    SphereSoA sphereSoA;
+    std::future<BVH> pendingBuild;
+    
+    // Scene edits from the UI, guarded by submitMutex. They are handed to the pass along with the scene they apply
+    // to: at the start of Render, or with the next submission in asynchronous mode.
+    bool accelerationDirty = true;
+    std::vector<uint32_t> dirtySpheres;
+    bool lightsDirty = true;
+    bool cameraMoved = false;
+    bool reprojectCameraMove = false;
+    
+    bool rebuildRequested = true;
+    std::vector<uint32_t> refitSpheres;
+    bool lightRebuildRequested = true;
+    bool reprojectRequested = false;
+    bool interactiveRequested = false;
+    
+    std::thread renderThread;
+    std::mutex submitMutex;
+    std::condition_variable submitted;
+    bool stopRequested = false;
+    
+    // Set to stop the pass in flight. Tiles and wavefront stages check it before starting.
+    std::atomic<bool> cancelRequested = false;
+    std::atomic<bool> resetRequested = false;
+    
+    // Latest submission, moved into the render thread's own copies at the start of its next pass
+    std::optional<Scene> pendingScene;
+    std::optional<Camera> pendingCamera;
+    uint32_t pendingWidth = 0;
+    uint32_t pendingHeight = 0;
+    Settings pendingSettings;
+    glm::vec3 pendingLightDirection;
+    
+    std::optional<Scene> threadScene;
+    std::optional<Camera> threadCamera;
+    
+    struct Frame {
+        Framebuffer image;
+        Statistics statistics;
+    };
+    
+    // Triple buffer: the render thread fills writeFrame and swaps it with readyFrame, and Present swaps readyFrame
+    // with presentFrame. Indices are guarded by submitMutex.
+    Frame frames[3];
+    int writeFrame = 0;
+    int readyFrame = 1;
+    int presentFrame = 2;
+    bool frameReady = false;
+    
+    struct WavefrontPath {
+        Ray ray;
+        PathState state;
+        Sampler sampler;
+        
+        float hitDistance;
+        int objectIndex;
+        
+        bool active;
+    };
+    
+    // Wavefront state, one path per pixel. The queue holds the live paths in the order the next stage processes them.
+    std::vector<WavefrontPath> wavefrontPaths;
+    std::vector<uint64_t> wavefrontKeys;
+    std::vector<uint32_t> wavefrontQueue;
+    
+    Statistics statistics;
 };
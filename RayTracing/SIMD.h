@@ -0,0 +1,232 @@
+//
+//  SIMD.h
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#pragma once
+
+// Thin 4-wide float wrapper over SSE on x86 and NEON on ARM, with a scalar fallback for anything else. Apple
+// silicon and the x86 render nodes both have 128-bit vectors, so 4 lanes is the common width.
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SIMD_SSE 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define SIMD_SCALAR 1
+#endif
+
+#include <cmath>
+#include <cstdint>
+
+namespace SIMD {
+
+    struct Float4 {
+
+#if SIMD_SSE
+        __m128 value;
+#elif SIMD_NEON
+        float32x4_t value;
+#else
+        float value[4];
+#endif
+
+        static Float4 Load(const float* data) {
+            Float4 result;
+#if SIMD_SSE
+            result.value = _mm_load_ps(data);
+#elif SIMD_NEON
+            result.value = vld1q_f32(data);
+#else
+            for (int lane = 0; lane < 4; lane++) {
+                result.value[lane] = data[lane];
+            }
+#endif
+            return result;
+        }
+
+        static Float4 LoadUnaligned(const float* data) {
+            Float4 result;
+#if SIMD_SSE
+            result.value = _mm_loadu_ps(data);
+#elif SIMD_NEON
+            result.value = vld1q_f32(data);
+#else
+            for (int lane = 0; lane < 4; lane++) {
+                result.value[lane] = data[lane];
+            }
+#endif
+            return result;
+        }
+
+        static Float4 Splat(float scalar) {
+            Float4 result;
+#if SIMD_SSE
+            result.value = _mm_set1_ps(scalar);
+#elif SIMD_NEON
+            result.value = vdupq_n_f32(scalar);
+#else
+            for (int lane = 0; lane < 4; lane++) {
+                result.value[lane] = scalar;
+            }
+#endif
+            return result;
+        }
+
+        void Store(float* data) const {
+#if SIMD_SSE
+            _mm_store_ps(data, value);
+#elif SIMD_NEON
+            vst1q_f32(data, value);
+#else
+            for (int lane = 0; lane < 4; lane++) {
+                data[lane] = value[lane];
+            }
+#endif
+        }
+    };
+
+    // Per-lane comparison result
+    struct Mask4 {
+
+#if SIMD_SSE
+        __m128 value;
+#elif SIMD_NEON
+        uint32x4_t value;
+#else
+        bool value[4];
+#endif
+    };
+
+#if SIMD_SCALAR
+    template<typename Operation>
+    inline Float4 PerLane(const Float4& lhs, const Float4& rhs, Operation operation) {
+        Float4 result;
+
+        for (int lane = 0; lane < 4; lane++) {
+            result.value[lane] = operation(lhs.value[lane], rhs.value[lane]);
+        }
+
+        return result;
+    }
+#endif
+
+    inline Float4 operator+(const Float4& lhs, const Float4& rhs) {
+#if SIMD_SSE
+        return { _mm_add_ps(lhs.value, rhs.value) };
+#elif SIMD_NEON
+        return { vaddq_f32(lhs.value, rhs.value) };
+#else
+        return PerLane(lhs, rhs, [](float a, float b) { return a + b; });
+#endif
+    }
+
+    inline Float4 operator-(const Float4& lhs, const Float4& rhs) {
+#if SIMD_SSE
+        return { _mm_sub_ps(lhs.value, rhs.value) };
+#elif SIMD_NEON
+        return { vsubq_f32(lhs.value, rhs.value) };
+#else
+        return PerLane(lhs, rhs, [](float a, float b) { return a - b; });
+#endif
+    }
+
+    inline Float4 operator*(const Float4& lhs, const Float4& rhs) {
+#if SIMD_SSE
+        return { _mm_mul_ps(lhs.value, rhs.value) };
+#elif SIMD_NEON
+        return { vmulq_f32(lhs.value, rhs.value) };
+#else
+        return PerLane(lhs, rhs, [](float a, float b) { return a * b; });
+#endif
+    }
+
+    inline Float4 operator/(const Float4& lhs, const Float4& rhs) {
+#if SIMD_SSE
+        return { _mm_div_ps(lhs.value, rhs.value) };
+#elif SIMD_NEON
+        return { vdivq_f32(lhs.value, rhs.value) };
+#else
+        return PerLane(lhs, rhs, [](float a, float b) { return a / b; });
+#endif
+    }
+
+    inline Float4 Sqrt(const Float4& value) {
+#if SIMD_SSE
+        return { _mm_sqrt_ps(value.value) };
+#elif SIMD_NEON
+        return { vsqrtq_f32(value.value) };
+#else
+        return PerLane(value, value, [](float a, float) { return std::sqrt(a); });
+#endif
+    }
+
+    inline Float4 Min(const Float4& lhs, const Float4& rhs) {
+#if SIMD_SSE
+        return { _mm_min_ps(lhs.value, rhs.value) };
+#elif SIMD_NEON
+        return { vminq_f32(lhs.value, rhs.value) };
+#else
+        return PerLane(lhs, rhs, [](float a, float b) { return a < b ? a : b; });
+#endif
+    }
+
+    inline Float4 Max(const Float4& lhs, const Float4& rhs) {
+#if SIMD_SSE
+        return { _mm_max_ps(lhs.value, rhs.value) };
+#elif SIMD_NEON
+        return { vmaxq_f32(lhs.value, rhs.value) };
+#else
+        return PerLane(lhs, rhs, [](float a, float b) { return a > b ? a : b; });
+#endif
+    }
+
+    inline Mask4 LessEqual(const Float4& lhs, const Float4& rhs) {
+#if SIMD_SSE
+        return { _mm_cmple_ps(lhs.value, rhs.value) };
+#elif SIMD_NEON
+        return { vcleq_f32(lhs.value, rhs.value) };
+#else
+        Mask4 result;
+
+        for (int lane = 0; lane < 4; lane++) {
+            result.value[lane] = lhs.value[lane] <= rhs.value[lane];
+        }
+
+        return result;
+#endif
+    }
+
+    inline Mask4 Less(const Float4& lhs, const Float4& rhs) {
+#if SIMD_SSE
+        return { _mm_cmplt_ps(lhs.value, rhs.value) };
+#elif SIMD_NEON
+        return { vcltq_f32(lhs.value, rhs.value) };
+#else
+        Mask4 result;
+
+        for (int lane = 0; lane < 4; lane++) {
+            result.value[lane] = lhs.value[lane] < rhs.value[lane];
+        }
+
+        return result;
+#endif
+    }
+
+    // Packs the lanes of a mask into the low 4 bits of an integer, lane 0 in bit 0
+    inline int MoveMask(const Mask4& mask) {
+#if SIMD_SSE
+        return _mm_movemask_ps(mask.value);
+#elif SIMD_NEON
+        static const int32_t shifts[4] = { 0, 1, 2, 3 };
+        uint32x4_t bits = vshlq_u32(vshrq_n_u32(mask.value, 31), vld1q_s32(shifts));
+        return static_cast<int>(vaddvq_u32(bits));
+#else
+        return (mask.value[0] ? 1 : 0) | (mask.value[1] ? 2 : 0) | (mask.value[2] ? 4 : 0) | (mask.value[3] ? 8 : 0);
+#endif
+    }
+}
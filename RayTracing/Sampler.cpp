@@ -0,0 +1,276 @@
+//
+//  Sampler.cpp
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#include "Sampler.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace Utils {
+
+    static constexpr uint32_t BlueNoiseSize = 64;
+
+    static float ToFloat(uint32_t value) {
+        return static_cast<float>(value >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Direction numbers for the first four Sobol dimensions, from the Joe-Kuo primitive polynomials
+    static std::array<std::array<uint32_t, 32>, Sampler::SetDimensions> MakeSobolDirections() {
+        struct Polynomial {
+            uint32_t degree;
+            uint32_t coefficients;
+            uint32_t initial[3];
+        };
+
+        const Polynomial polynomials[Sampler::SetDimensions - 1] = {
+            { 1, 0, { 1, 0, 0 } },
+            { 2, 1, { 1, 3, 0 } },
+            { 3, 1, { 1, 3, 1 } }
+        };
+
+        std::array<std::array<uint32_t, 32>, Sampler::SetDimensions> directions {};
+
+        // The first dimension is the van der Corput sequence
+        for (uint32_t bit = 0; bit < 32; bit += 1) {
+            directions[0][bit] = 1u << (31 - bit);
+        }
+
+        for (uint32_t dimension = 1; dimension < Sampler::SetDimensions; dimension += 1) {
+            const Polynomial& polynomial = polynomials[dimension - 1];
+            std::array<uint32_t, 32>& numbers = directions[dimension];
+
+            for (uint32_t bit = 0; bit < polynomial.degree; bit += 1) {
+                numbers[bit] = polynomial.initial[bit] << (31 - bit);
+            }
+
+            for (uint32_t bit = polynomial.degree; bit < 32; bit += 1) {
+                numbers[bit] = numbers[bit - polynomial.degree] ^ (numbers[bit - polynomial.degree] >> polynomial.degree);
+
+                for (uint32_t term = 1; term < polynomial.degree; term += 1) {
+                    if ((polynomial.coefficients >> (polynomial.degree - 1 - term)) & 1) {
+                        numbers[bit] ^= numbers[bit - term];
+                    }
+                }
+            }
+        }
+
+        return directions;
+    }
+
+    // A tileable blue noise mask from the void-and-cluster method: pixels are ranked by repeatedly filling the
+    // largest gap in a pattern, measured with a toroidal Gaussian, so every threshold of the mask is evenly spread.
+    static std::vector<float> MakeBlueNoise() {
+        constexpr uint32_t Size = BlueNoiseSize;
+        constexpr uint32_t PixelCount = Size * Size;
+        constexpr float Sigma = 1.5f;
+
+        // Energy each pixel adds at every offset, wrapping around the tile
+        std::vector<float> kernel(PixelCount);
+
+        for (uint32_t y = 0; y < Size; y += 1) {
+            for (uint32_t x = 0; x < Size; x += 1) {
+                float dx = static_cast<float>(std::min(x, Size - x));
+                float dy = static_cast<float>(std::min(y, Size - y));
+
+                kernel[x + y * Size] = std::exp(-(dx * dx + dy * dy) / (2.0f * Sigma * Sigma));
+            }
+        }
+
+        std::vector<uint8_t> pattern(PixelCount, 0);
+        std::vector<float> energy(PixelCount, 0.0f);
+
+        auto toggle = [&](uint32_t pixel, bool set) {
+            pattern[pixel] = set ? 1 : 0;
+
+            uint32_t pixelX = pixel % Size;
+            uint32_t pixelY = pixel / Size;
+            float sign = set ? 1.0f : -1.0f;
+
+            for (uint32_t y = 0; y < Size; y += 1) {
+                for (uint32_t x = 0; x < Size; x += 1) {
+                    energy[x + y * Size] += sign * kernel[((x - pixelX) & (Size - 1)) + ((y - pixelY) & (Size - 1)) * Size];
+                }
+            }
+        };
+
+        // The set pixel with the most energy around it, or the empty one with the least
+        auto find = [&](bool tightestCluster) {
+            uint32_t best = 0;
+            float bestEnergy = tightestCluster ? -1.0f : std::numeric_limits<float>::max();
+
+            for (uint32_t pixel = 0; pixel < PixelCount; pixel += 1) {
+                if (pattern[pixel] != (tightestCluster ? 1 : 0)) {
+                    continue;
+                }
+
+                if (tightestCluster ? energy[pixel] > bestEnergy : energy[pixel] < bestEnergy) {
+                    best = pixel;
+                    bestEnergy = energy[pixel];
+                }
+            }
+
+            return best;
+        };
+
+        // Start from a random tenth of the pixels, then move the tightest cluster into the largest void until that
+        // stops changing anything
+        RandomSequence random;
+        uint32_t initialCount = PixelCount / 10;
+
+        for (uint32_t count = 0; count < initialCount;) {
+            uint32_t pixel = random.UInt() % PixelCount;
+
+            if (pattern[pixel] == 0) {
+                toggle(pixel, true);
+                count += 1;
+            }
+        }
+
+        for (uint32_t iteration = 0; iteration < PixelCount; iteration += 1) {
+            uint32_t cluster = find(true);
+            toggle(cluster, false);
+
+            uint32_t gap = find(false);
+            toggle(gap, true);
+
+            if (gap == cluster) {
+                break;
+            }
+        }
+
+        std::vector<uint32_t> ranks(PixelCount, 0);
+        std::vector<uint8_t> initialPattern = pattern;
+        std::vector<float> initialEnergy = energy;
+
+        // The initial pixels are ranked by removing them, tightest cluster first
+        for (uint32_t rank = initialCount; rank > 0; rank -= 1) {
+            uint32_t cluster = find(true);
+            toggle(cluster, false);
+            ranks[cluster] = rank - 1;
+        }
+
+        // And the rest by filling the largest void
+        pattern = initialPattern;
+        energy = initialEnergy;
+
+        for (uint32_t rank = initialCount; rank < PixelCount; rank += 1) {
+            uint32_t gap = find(false);
+            toggle(gap, true);
+            ranks[gap] = rank;
+        }
+
+        std::vector<float> noise(PixelCount);
+
+        for (uint32_t pixel = 0; pixel < PixelCount; pixel += 1) {
+            noise[pixel] = (static_cast<float>(ranks[pixel]) + 0.5f) / static_cast<float>(PixelCount);
+        }
+
+        return noise;
+    }
+}
+
+Sampler::Sampler(Type type, uint32_t x, uint32_t y, uint32_t pixelIndex, uint32_t sampleIndex, uint32_t seed) :
+    type(type),
+    x(x),
+    y(y),
+    imageSeed(RandomSequence::Hash(seed)),
+    pixelSeed(RandomSequence::Hash(pixelIndex ^ imageSeed)),
+    sampleIndex(sampleIndex),
+    random(pixelSeed, sampleIndex)
+{
+}
+
+float Sampler::Next() {
+    if (type == Type::Random) {
+        return random.Float();
+    }
+
+    if (dimension == SetDimensions) {
+        set += 1;
+        dimension = 0;
+    }
+
+    uint32_t currentDimension = dimension++;
+
+    // Blue noise shares one scramble between all pixels, so the shift alone decides how pixels differ
+    uint32_t setSeed = RandomSequence::Hash((type == Type::Sobol ? pixelSeed : imageSeed) + set * 0x9E3779B9u);
+
+    uint32_t index = NestedUniformScramble(sampleIndex, setSeed);
+    uint32_t value = NestedUniformScramble(Sobol(index, currentDimension), RandomSequence::Hash(setSeed ^ currentDimension));
+
+    if (type == Type::BlueNoise) {
+        // A different window of the tile for every dimension, so the shifts are not correlated across dimensions
+        uint32_t window = RandomSequence::Hash(imageSeed + set * SetDimensions + currentDimension);
+        float shift = BlueNoise(x + window, y + (window >> 16));
+
+        float shifted = Utils::ToFloat(value) + shift;
+
+        return shifted >= 1.0f ? shifted - 1.0f : shifted;
+    }
+
+    return Utils::ToFloat(value);
+}
+
+glm::vec3 Sampler::Vec3(float min, float max) {
+    if (type != Type::Random && dimension + 3 > SetDimensions) {
+        set += 1;
+        dimension = 0;
+    }
+
+    glm::vec3 value;
+    value.x = Next();
+    value.y = Next();
+    value.z = Next();
+
+    return value * (max - min) + min;
+}
+
+uint32_t Sampler::Sobol(uint32_t index, uint32_t dimension) {
+    static const std::array<std::array<uint32_t, 32>, SetDimensions> directions = Utils::MakeSobolDirections();
+
+    uint32_t result = 0;
+
+    for (uint32_t bit = 0; index != 0; bit += 1, index >>= 1) {
+        if (index & 1) {
+            result ^= directions[dimension][bit];
+        }
+    }
+
+    return result;
+}
+
+uint32_t Sampler::NestedUniformScramble(uint32_t value, uint32_t seed) {
+    // Laine-Karras style hash. Applied to the reversed bits, it only lets each bit depend on the bits above it,
+    // which is exactly an Owen scramble.
+    value = ReverseBits(value);
+
+    value += seed;
+    value ^= value * 0x6C50B47Cu;
+    value ^= value * 0xB82F1E52u;
+    value ^= value * 0xC7AFE638u;
+    value ^= value * 0x8D22F6E6u;
+
+    return ReverseBits(value);
+}
+
+uint32_t Sampler::ReverseBits(uint32_t value) {
+    value = ((value >> 1) & 0x55555555u) | ((value & 0x55555555u) << 1);
+    value = ((value >> 2) & 0x33333333u) | ((value & 0x33333333u) << 2);
+    value = ((value >> 4) & 0x0F0F0F0Fu) | ((value & 0x0F0F0F0Fu) << 4);
+    value = ((value >> 8) & 0x00FF00FFu) | ((value & 0x00FF00FFu) << 8);
+
+    return (value >> 16) | (value << 16);
+}
+
+float Sampler::BlueNoise(uint32_t x, uint32_t y) {
+    static const std::vector<float> noise = Utils::MakeBlueNoise();
+
+    return noise[(x % Utils::BlueNoiseSize) + (y % Utils::BlueNoiseSize) * Utils::BlueNoiseSize];
+}
@@ -0,0 +1,67 @@
+//
+//  Sampler.h
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#pragma once
+
+#include "RandomSequence.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+// The sample values of one path. Every value is indexed by pixel, sample (the frame being accumulated) and
+// dimension, the count of values the path has drawn so far, so all types are deterministic regardless of which
+// thread renders the path.
+class Sampler {
+
+public:
+
+    enum class Type {
+        Random,    // White noise from RandomSequence
+        Sobol,     // Owen-scrambled Sobol points, scrambled per pixel. Each bounce draws from a fresh 4D Sobol set.
+        BlueNoise  // The same Sobol point for every pixel, toroidally shifted by a blue noise tile, so the error of
+                   // neighbouring pixels is decorrelated and reads as fine grain rather than blotches
+    };
+
+    // Consecutive dimensions are taken from one padded 4D set before the next set starts
+    static constexpr uint32_t SetDimensions = 4;
+
+public:
+
+    Sampler() = default;
+    // A different seed gives independent values for the same pixel and sample
+    Sampler(Type type, uint32_t x, uint32_t y, uint32_t pixelIndex, uint32_t sampleIndex, uint32_t seed);
+
+    // The next dimension, in [0, 1)
+    float Next();
+
+    // Three dimensions from one 4D set, scaled to [min, max). Starts a new set when the current one has fewer left.
+    glm::vec3 Vec3(float min, float max);
+
+private:
+
+    static uint32_t Sobol(uint32_t index, uint32_t dimension);
+    static uint32_t NestedUniformScramble(uint32_t value, uint32_t seed);
+    static uint32_t ReverseBits(uint32_t value);
+
+    static float BlueNoise(uint32_t x, uint32_t y);
+
+private:
+
+    Type type = Type::Random;
+
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t imageSeed = 0;
+    uint32_t pixelSeed = 0;
+    uint32_t sampleIndex = 0;
+
+    uint32_t set = 0;
+    uint32_t dimension = 0;
+
+    RandomSequence random;
+};
@@ -9,12 +9,21 @@
 
 #include <glm/glm.hpp>
 
+#include "EnvironmentMap.h"
+
+#include <memory>
 #include <vector>
 
 struct Material {
     glm::vec3 albedo { 1.0f };
     float roughness = 1.0f;
     float metallic = 0.0f;
+    
+    // Radiance the surface emits, in every direction
+    glm::vec3 emissionColor { 0.0f };
+    float emissionPower = 0.0f;
+    
+    glm::vec3 GetEmission() const { return emissionColor * emissionPower; }
 };
 
 struct Sphere {
@@ -27,4 +36,8 @@ struct Sphere {
 struct Scene {
     std::vector<Sphere> spheres;
     std::vector<Material> materials;
+    
+    // Lights the scene in place of the sky color and the directional light. Shared, so copies of the scene for the
+    // render thread do not copy the image.
+    std::shared_ptr<const EnvironmentMap> environment;
 };
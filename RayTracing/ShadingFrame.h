@@ -0,0 +1,37 @@
+//
+//  ShadingFrame.h
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+// Orthonormal frame around a unit vector, which becomes the local z axis. Built without branches, from Duff et al.,
+// "Building an Orthonormal Basis, Revisited".
+struct ShadingFrame {
+    glm::vec3 tangent;
+    glm::vec3 bitangent;
+    glm::vec3 normal;
+
+    explicit ShadingFrame(const glm::vec3& normal) : normal(normal) {
+        float sign = std::copysign(1.0f, normal.z);
+        float a = -1.0f / (sign + normal.z);
+        float b = normal.x * normal.y * a;
+
+        tangent = glm::vec3(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+        bitangent = glm::vec3(b, sign + normal.y * normal.y * a, -normal.y);
+    }
+
+    glm::vec3 ToLocal(const glm::vec3& vector) const {
+        return glm::vec3(glm::dot(vector, tangent), glm::dot(vector, bitangent), glm::dot(vector, normal));
+    }
+
+    glm::vec3 ToWorld(const glm::vec3& vector) const {
+        return tangent * vector.x + bitangent * vector.y + normal * vector.z;
+    }
+};
@@ -0,0 +1,215 @@
+//
+//  SphereSoA.cpp
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#include "SphereSoA.h"
+
+#include "SIMD.h"
+
+void SphereSoA::Build(const std::vector<Sphere>& spheres, const std::vector<uint32_t>& order) {
+    sphereCount = static_cast<uint32_t>(order.size());
+
+    size_t paddedCount = ((sphereCount + 3) & ~size_t(3)) + 4;
+
+    positionsX.assign(paddedCount, 0.0f);
+    positionsY.assign(paddedCount, 0.0f);
+    positionsZ.assign(paddedCount, 0.0f);
+    radiiSquared.assign(paddedCount, 0.0f);
+
+    sphereIndices = order;
+    slots.resize(spheres.size());
+
+    for (uint32_t slot = 0; slot < sphereCount; slot += 1) {
+        slots[order[slot]] = slot;
+        Store(slot, spheres[order[slot]]);
+    }
+}
+
+void SphereSoA::Update(const std::vector<Sphere>& spheres, const std::vector<uint32_t>& dirtySpheres) {
+    for (uint32_t sphereIndex : dirtySpheres) {
+        if (sphereIndex >= slots.size()) {
+            continue;
+        }
+
+        Store(slots[sphereIndex], spheres[sphereIndex]);
+    }
+}
+
+void SphereSoA::Store(uint32_t slot, const Sphere& sphere) {
+    positionsX[slot] = sphere.position.x;
+    positionsY[slot] = sphere.position.y;
+    positionsZ[slot] = sphere.position.z;
+    radiiSquared[slot] = sphere.radius * sphere.radius;
+}
+
+bool SphereSoA::Intersect(const Ray& ray, uint32_t first, uint32_t count, float& hitDistance, int& objectIndex) const {
+    using namespace SIMD;
+
+    // Same quadratic as Intersection::RaySphere, with a shared across the lanes
+    float a = glm::dot(ray.direction, ray.direction);
+
+    Float4 originX = Float4::Splat(ray.origin.x);
+    Float4 originY = Float4::Splat(ray.origin.y);
+    Float4 originZ = Float4::Splat(ray.origin.z);
+
+    Float4 directionX = Float4::Splat(ray.direction.x);
+    Float4 directionY = Float4::Splat(ray.direction.y);
+    Float4 directionZ = Float4::Splat(ray.direction.z);
+
+    Float4 zero = Float4::Splat(0.0f);
+    Float4 two = Float4::Splat(2.0f);
+    Float4 fourA = Float4::Splat(4.0f * a);
+    Float4 inverseTwoA = Float4::Splat(1.0f / (2.0f * a));
+
+    bool hit = false;
+    uint32_t last = first + count;
+
+    for (uint32_t slot = first; slot < last; slot += 4) {
+        Float4 offsetX = originX - Float4::LoadUnaligned(&positionsX[slot]);
+        Float4 offsetY = originY - Float4::LoadUnaligned(&positionsY[slot]);
+        Float4 offsetZ = originZ - Float4::LoadUnaligned(&positionsZ[slot]);
+
+        Float4 b = two * (offsetX * directionX + offsetY * directionY + offsetZ * directionZ);
+        Float4 c = offsetX * offsetX + offsetY * offsetY + offsetZ * offsetZ - Float4::LoadUnaligned(&radiiSquared[slot]);
+
+        Float4 discriminant = b * b - fourA * c;
+        Float4 distance = (zero - b - Sqrt(Max(discriminant, zero))) * inverseTwoA;
+
+        int hitMask = MoveMask(LessEqual(zero, discriminant))
+            & MoveMask(Less(zero, distance))
+            & MoveMask(Less(distance, Float4::Splat(hitDistance)));
+
+        // Lanes past the end of the range belong to the next leaf or the padding
+        if (last - slot < 4) {
+            hitMask &= (1 << (last - slot)) - 1;
+        }
+
+        if (hitMask == 0) {
+            continue;
+        }
+
+        alignas(16) float distances[4];
+        distance.Store(distances);
+
+        for (int lane = 0; lane < 4; lane++) {
+            if ((hitMask & (1 << lane)) && distances[lane] < hitDistance) {
+                hitDistance = distances[lane];
+                objectIndex = static_cast<int>(sphereIndices[slot + lane]);
+                hit = true;
+            }
+        }
+    }
+
+    return hit;
+}
+
+bool SphereSoA::Occluded(const Ray& ray, uint32_t first, uint32_t count, float maxDistance) const {
+    using namespace SIMD;
+
+    float a = glm::dot(ray.direction, ray.direction);
+
+    Float4 originX = Float4::Splat(ray.origin.x);
+    Float4 originY = Float4::Splat(ray.origin.y);
+    Float4 originZ = Float4::Splat(ray.origin.z);
+
+    Float4 directionX = Float4::Splat(ray.direction.x);
+    Float4 directionY = Float4::Splat(ray.direction.y);
+    Float4 directionZ = Float4::Splat(ray.direction.z);
+
+    Float4 zero = Float4::Splat(0.0f);
+    Float4 two = Float4::Splat(2.0f);
+    Float4 fourA = Float4::Splat(4.0f * a);
+    Float4 inverseTwoA = Float4::Splat(1.0f / (2.0f * a));
+    Float4 limit = Float4::Splat(maxDistance);
+
+    uint32_t last = first + count;
+
+    for (uint32_t slot = first; slot < last; slot += 4) {
+        Float4 offsetX = originX - Float4::LoadUnaligned(&positionsX[slot]);
+        Float4 offsetY = originY - Float4::LoadUnaligned(&positionsY[slot]);
+        Float4 offsetZ = originZ - Float4::LoadUnaligned(&positionsZ[slot]);
+
+        Float4 b = two * (offsetX * directionX + offsetY * directionY + offsetZ * directionZ);
+        Float4 c = offsetX * offsetX + offsetY * offsetY + offsetZ * offsetZ - Float4::LoadUnaligned(&radiiSquared[slot]);
+
+        Float4 discriminant = b * b - fourA * c;
+        Float4 distance = (zero - b - Sqrt(Max(discriminant, zero))) * inverseTwoA;
+
+        int hitMask = MoveMask(LessEqual(zero, discriminant))
+            & MoveMask(Less(zero, distance))
+            & MoveMask(Less(distance, limit));
+
+        if (last - slot < 4) {
+            hitMask &= (1 << (last - slot)) - 1;
+        }
+
+        if (hitMask != 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void SphereSoA::IntersectPacket(const RayPacket& packet, int firstRay, uint32_t first, uint32_t count, float* hitDistances, int* objectIndices) const {
+    using namespace SIMD;
+
+    Float4 zero = Float4::Splat(0.0f);
+    Float4 two = Float4::Splat(2.0f);
+    Float4 four = Float4::Splat(4.0f);
+
+    uint32_t last = first + count;
+
+    for (int group = firstRay & ~3; group < RayPacket::Size; group += 4) {
+        Float4 directionX = Float4::Load(&packet.directionX[group]);
+        Float4 directionY = Float4::Load(&packet.directionY[group]);
+        Float4 directionZ = Float4::Load(&packet.directionZ[group]);
+
+        Float4 a = directionX * directionX + directionY * directionY + directionZ * directionZ;
+        Float4 fourA = four * a;
+        
+        // Matches the reciprocal in Intersect, so a packet and a single ray agree on the hit distance
+        alignas(16) float inverseTwoA[4];
+        a.Store(inverseTwoA);
+        
+        for (int lane = 0; lane < 4; lane++) {
+            inverseTwoA[lane] = 1.0f / (2.0f * inverseTwoA[lane]);
+        }
+
+        // Rays before firstRay already missed the box that led here
+        int activeMask = group < firstRay ? (0xF << (firstRay - group)) & 0xF : 0xF;
+
+        for (uint32_t slot = first; slot < last; slot += 1) {
+            glm::vec3 offset = packet.origin - glm::vec3(positionsX[slot], positionsY[slot], positionsZ[slot]);
+            float c = glm::dot(offset, offset) - radiiSquared[slot];
+
+            Float4 b = two * (Float4::Splat(offset.x) * directionX + Float4::Splat(offset.y) * directionY + Float4::Splat(offset.z) * directionZ);
+
+            Float4 discriminant = b * b - fourA * Float4::Splat(c);
+            int hitMask = MoveMask(LessEqual(zero, discriminant)) & activeMask;
+
+            if (hitMask == 0) {
+                continue;
+            }
+
+            alignas(16) float distances[4];
+            (zero - b - Sqrt(Max(discriminant, zero))).Store(distances);
+
+            for (int lane = 0; lane < 4; lane++) {
+                if ((hitMask & (1 << lane)) == 0) {
+                    continue;
+                }
+
+                float distance = distances[lane] * inverseTwoA[lane];
+
+                if (distance > 0.0f && distance < hitDistances[group + lane]) {
+                    hitDistances[group + lane] = distance;
+                    objectIndices[group + lane] = static_cast<int>(sphereIndices[slot]);
+                }
+            }
+        }
+    }
+}
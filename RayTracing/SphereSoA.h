@@ -0,0 +1,59 @@
+//
+//  SphereSoA.h
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Ray.h"
+#include "Scene.h"
+
+#include <vector>
+
+// Structure-of-arrays mirror of Scene::spheres, holding only what the intersection test reads. Spheres are stored in
+// the order given to Build (the BVH primitive order), so a BVH leaf is one contiguous run that the 4-wide kernel
+// walks directly.
+class SphereSoA {
+
+public:
+
+    SphereSoA() = default;
+
+    void Build(const std::vector<Sphere>& spheres, const std::vector<uint32_t>& order);
+    void Update(const std::vector<Sphere>& spheres, const std::vector<uint32_t>& dirtySpheres);
+
+    // Closest hit among slots [first, first + count), tested 4 spheres at a time. hitDistance is the current closest
+    // distance on input, and objectIndex receives the Scene::spheres index of anything closer.
+    bool Intersect(const Ray& ray, uint32_t first, uint32_t count, float& hitDistance, int& objectIndex) const;
+
+    // Whether any sphere among slots [first, first + count) is hit closer than maxDistance. Stops at the first group
+    // with a hit, and never works out which sphere or distance it was.
+    bool Occluded(const Ray& ray, uint32_t first, uint32_t count, float maxDistance) const;
+    
+    // Packet version of Intersect for rays [firstRay, RayPacket::Size), testing 4 rays against each sphere at a time.
+    // The shared origin makes the sphere's side of the quadratic a scalar.
+    void IntersectPacket(const RayPacket& packet, int firstRay, uint32_t first, uint32_t count, float* hitDistances, int* objectIndices) const;
+
+    uint32_t GetCount() const { return sphereCount; }
+
+private:
+
+    void Store(uint32_t slot, const Sphere& sphere);
+
+private:
+
+    uint32_t sphereCount = 0;
+
+    // Padded to a multiple of 4 plus one extra group, so the kernel can always load full lanes
+    std::vector<float> positionsX;
+    std::vector<float> positionsY;
+    std::vector<float> positionsZ;
+    std::vector<float> radiiSquared;
+
+    std::vector<uint32_t> sphereIndices; // Slot -> Scene::spheres index
+    std::vector<uint32_t> slots;         // Scene::spheres index -> slot
+};
@@ -0,0 +1,230 @@
+//
+//  TileScheduler.cpp
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#include "TileScheduler.h"
+
+#include <Walnut/Timer.h>
+
+#include <algorithm>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#include <pthread.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+TileScheduler::~TileScheduler() {
+    Stop();
+}
+
+void TileScheduler::Configure(uint32_t workerCount, bool pinWorkers) {
+    if (workerCount == 0) {
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    if (workerCount == workers.size() && pinWorkers == pinned) {
+        return;
+    }
+
+    Stop();
+
+    stopping = false;
+    pinned = pinWorkers;
+
+    for (uint32_t index = 0; index < workerCount; index += 1) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+
+    // Every worker exists before any of them can try to steal
+    for (uint32_t index = 0; index < workerCount; index += 1) {
+        workers[index]->thread = std::thread(&TileScheduler::WorkerLoop, this, index);
+
+        if (pinned) {
+            Pin(workers[index]->thread, index);
+        }
+    }
+}
+
+void TileScheduler::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    wake.notify_all();
+
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+
+    workers.clear();
+}
+
+void TileScheduler::Run(uint32_t count, const Task& task) {
+    if (identityOrder.size() != count) {
+        identityOrder.resize(count);
+
+        for (uint32_t index = 0; index < count; index += 1) {
+            identityOrder[index] = index;
+        }
+    }
+
+    Run(identityOrder, task);
+}
+
+void TileScheduler::Run(const std::vector<uint32_t>& order, const Task& task) {
+    if (workers.empty()) {
+        Configure(0, false);
+    }
+
+    if (order.empty()) {
+        return;
+    }
+
+    uint32_t workerCount = static_cast<uint32_t>(workers.size());
+    uint32_t taskCount = static_cast<uint32_t>(order.size());
+
+    // Nothing can be running yet, so the counters can be reset without racing a worker
+    for (auto& worker : workers) {
+        worker->busyTime = 0.0f;
+        worker->steals = 0;
+    }
+
+    // Published before any task is, since a worker still stealing from the previous Run can pick one up right away
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentTask = &task;
+    }
+
+    remaining = taskCount;
+
+    for (uint32_t index = 0; index < workerCount; index += 1) {
+        Worker& worker = *workers[index];
+
+        uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(taskCount) * index / workerCount);
+        uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(taskCount) * (index + 1) / workerCount);
+
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.assign(order.begin() + first, order.begin() + last);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation += 1;
+    }
+
+    wake.notify_all();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this]() { return remaining.load() == 0; });
+        currentTask = nullptr;
+    }
+
+    statistics.steals = 0;
+    statistics.busyTimes.resize(workerCount);
+
+    for (uint32_t index = 0; index < workerCount; index += 1) {
+        statistics.steals += workers[index]->steals;
+        statistics.busyTimes[index] = workers[index]->busyTime;
+    }
+}
+
+void TileScheduler::WorkerLoop(uint32_t workerIndex) {
+    uint64_t seenGeneration = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seenGeneration]() { return stopping || generation != seenGeneration; });
+
+            if (stopping) {
+                return;
+            }
+
+            seenGeneration = generation;
+        }
+
+        RunTasks(workerIndex);
+    }
+}
+
+void TileScheduler::RunTasks(uint32_t workerIndex) {
+    Worker& worker = *workers[workerIndex];
+    uint32_t taskIndex = 0;
+
+    while (PopTask(workerIndex, taskIndex) || StealTask(workerIndex, taskIndex)) {
+        Walnut::Timer timer;
+        (*currentTask)(taskIndex, workerIndex);
+
+        // Recorded before the countdown, so Run sees it once the last task is done
+        worker.busyTime += timer.Elapsed();
+
+        if (--remaining == 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.notify_all();
+        }
+    }
+}
+
+bool TileScheduler::PopTask(uint32_t workerIndex, uint32_t& taskIndex) {
+    Worker& worker = *workers[workerIndex];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+
+    if (worker.tasks.empty()) {
+        return false;
+    }
+
+    taskIndex = worker.tasks.front();
+    worker.tasks.pop_front();
+
+    return true;
+}
+
+bool TileScheduler::StealTask(uint32_t workerIndex, uint32_t& taskIndex) {
+    uint32_t workerCount = static_cast<uint32_t>(workers.size());
+
+    for (uint32_t offset = 1; offset < workerCount; offset += 1) {
+        Worker& victim = *workers[(workerIndex + offset) % workerCount];
+        std::unique_lock<std::mutex> lock(victim.mutex);
+
+        // Taking from the back leaves the victim the tiles next to the one it is working on
+        if (victim.tasks.empty()) {
+            continue;
+        }
+
+        taskIndex = victim.tasks.back();
+        victim.tasks.pop_back();
+        lock.unlock();
+
+        workers[workerIndex]->steals += 1;
+
+        return true;
+    }
+
+    return false;
+}
+
+void TileScheduler::Pin(std::thread& thread, uint32_t core) {
+#if defined(__APPLE__)
+    // Threads sharing a tag are kept on the same L2 where the kernel supports it. Distinct tags spread them out.
+    thread_affinity_policy_data_t policy = { static_cast<integer_t>(core + 1) };
+    thread_policy_set(pthread_mach_thread_np(thread.native_handle()), THREAD_AFFINITY_POLICY, reinterpret_cast<thread_policy_t>(&policy), THREAD_AFFINITY_POLICY_COUNT);
+#elif defined(__linux__)
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+    CPU_SET(core % std::max(1u, std::thread::hardware_concurrency()), &cores);
+
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cores);
+#else
+    (void)thread;
+    (void)core;
+#endif
+}
@@ -0,0 +1,136 @@
+//
+//  TileScheduler.h
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed pool of worker threads that runs a batch of tasks with work stealing. Each Run splits the task order into
+// contiguous runs, one per worker, so neighbouring tasks stay on the same thread. A worker that finishes its run
+// steals from the far end of another worker's run, which evens out tiles that take much longer than their neighbours.
+class TileScheduler {
+
+public:
+
+    struct Statistics {
+        uint32_t steals = 0;
+
+        // Seconds each worker spent running tasks during the last Run
+        std::vector<float> busyTimes;
+    };
+
+    using Task = std::function<void(uint32_t taskIndex, uint32_t workerIndex)>;
+
+public:
+
+    TileScheduler() = default;
+    ~TileScheduler();
+
+    TileScheduler(const TileScheduler&) = delete;
+    TileScheduler& operator=(const TileScheduler&) = delete;
+
+    // Starts the workers, restarting them when the count or pinning changed. A count of 0 uses one worker per core.
+    // Pinning binds worker N to core N on Linux, and is an affinity hint on macOS, which makes no guarantees.
+    void Configure(uint32_t workerCount, bool pinWorkers);
+
+    // Runs task for every entry of order and returns once all of them have finished
+    void Run(const std::vector<uint32_t>& order, const Task& task);
+
+    // Runs task for every index in [0, count)
+    void Run(uint32_t count, const Task& task);
+
+    // Runs body(first, last) over [0, count) in contiguous chunks of chunkSize, one task per chunk
+    template<typename Body>
+    void ParallelFor(uint32_t count, uint32_t chunkSize, const Body& body) {
+        uint32_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+        Run(chunkCount, [&body, count, chunkSize](uint32_t chunk, uint32_t) {
+            uint32_t first = chunk * chunkSize;
+            body(first, std::min(first + chunkSize, count));
+        });
+    }
+
+    // Reduces map(index) over [0, count) with reduce, starting from identity. Each chunk is reduced on a worker and
+    // the chunks are combined in order, so the result does not depend on which worker ran what.
+    template<typename T, typename Map, typename Reduce>
+    T ParallelReduce(uint32_t count, uint32_t chunkSize, T identity, const Map& map, const Reduce& reduce) {
+        uint32_t chunkCount = (count + chunkSize - 1) / chunkSize;
+        std::vector<T> partials(chunkCount, identity);
+
+        Run(chunkCount, [&](uint32_t chunk, uint32_t) {
+            uint32_t first = chunk * chunkSize;
+            uint32_t last = std::min(first + chunkSize, count);
+
+            T partial = identity;
+
+            for (uint32_t index = first; index < last; index += 1) {
+                partial = reduce(partial, map(index));
+            }
+
+            partials[chunk] = partial;
+        });
+
+        T result = identity;
+
+        for (const T& partial : partials) {
+            result = reduce(result, partial);
+        }
+
+        return result;
+    }
+
+    uint32_t GetWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+    const Statistics& GetStatistics() const { return statistics; }
+
+private:
+
+    struct Worker {
+        std::thread thread;
+
+        std::mutex mutex;
+        std::deque<uint32_t> tasks;
+
+        float busyTime = 0.0f;
+        uint32_t steals = 0;
+    };
+
+    void Stop();
+    void WorkerLoop(uint32_t workerIndex);
+    void RunTasks(uint32_t workerIndex);
+
+    bool PopTask(uint32_t workerIndex, uint32_t& taskIndex);
+    bool StealTask(uint32_t workerIndex, uint32_t& taskIndex);
+
+    static void Pin(std::thread& thread, uint32_t core);
+
+private:
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    bool pinned = false;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    const Task* currentTask = nullptr;
+    std::atomic<uint32_t> remaining = 0;
+
+    std::vector<uint32_t> identityOrder;
+
+    Statistics statistics;
+};
@@ -7,15 +7,27 @@
 
 #include <Walnut/Application.h>
 #include <Walnut/EntryPoint.h>
+#include <Walnut/Image.h>
 #include <Walnut/Timer.h>
 
+#include <Walnut/Random.h>
+
 #include <glm/gtc/type_ptr.hpp>
 
 #include <imgui.h>
 
+// The implementation is compiled into Walnut's Image
+#include <stb_image.h>
+
 #include "Camera.h"
 #include "Renderer.h"
 
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+
 using namespace Walnut;
 
 class ExampleLayer : public Walnut::Layer
@@ -56,7 +68,8 @@ public:
         bool moved = camera.OnUpdate(ts);
         
         if (moved) {
-            renderer.ResetFrameIndex();
+            renderer.OnCameraMoved();
+            renderDirty = true;
         }
     }
     
@@ -67,8 +80,6 @@ public:
         viewportWidth = ImGui::GetContentRegionAvail().x;
         viewportHeight = ImGui::GetContentRegionAvail().y;
 
-        auto image = renderer.GetFinalImage();
-
         if (image != nullptr) {
             ImGui::Image(
                 image->GetDescriptorSet(),
@@ -82,14 +93,70 @@ public:
         ImGui::PopStyleVar();
         
         ImGui::Begin("Settings");
-        ImGui::Text("Last render: %.3fms", lastRenderTime);
+        const Renderer::Statistics& renderStatistics = renderer.GetStatistics();
+        
+        ImGui::Text("Last render: %.3fms (%.2f Msamples/s)", lastRenderTime, renderStatistics.samplesPerSecond / 1.0e6f);
         ImGui::Text("Viewport: %ux%u", viewportWidth, viewportHeight);
+        ImGui::Text("Samples: %u (pass %.0f%%)", renderStatistics.frameIndex - 1, renderStatistics.passProgress * 100.0f);
+        
+        if (renderStatistics.renderScale > 1) {
+            ImGui::Text("Moving: 1 of %ux%u pixels", renderStatistics.renderScale, renderStatistics.renderScale);
+        }
+        
+        if (renderer.GetSettings().adaptiveSampling) {
+            ImGui::Text("Converged tiles: %.0f%%", renderStatistics.convergedFraction * 100.0f);
+        }
+        
+        if (renderer.GetSettings().denoise) {
+            ImGui::Text("Denoise: %.3fms", renderStatistics.denoiseTime);
+        }
+        
+        const BVH::Statistics& bvhStatistics = renderStatistics.accelerationStructure;
+        ImGui::Text("BVH build: %.3fms", bvhStatistics.buildTime);
+        ImGui::Text("BVH nodes: %u (%u leaves, depth %u)", bvhStatistics.nodeCount, bvhStatistics.leafCount, bvhStatistics.maxDepth);
+        ImGui::Text("BVH refit: %.3fms (quality %.2fx)%s", bvhStatistics.refitTime, renderStatistics.accelerationQuality, renderStatistics.rebuildingAccelerationStructure ? ", rebuilding" : "");
+        ImGui::Text("Nodes / ray: %.2f", renderStatistics.NodesPerRay());
+        
+        if (!renderStatistics.tileTimes.empty()) {
+            float slowestTile = *std::max_element(renderStatistics.tileTimes.begin(), renderStatistics.tileTimes.end());
+            float meanTile = std::accumulate(renderStatistics.tileTimes.begin(), renderStatistics.tileTimes.end(), 0.0f) / renderStatistics.tileTimes.size();
+            
+            ImGui::Text("Tiles: %ux%u, mean %.3fms, slowest %.3fms", renderStatistics.tileColumns, renderStatistics.tileRows, meanTile, slowestTile);
+            ImGui::PlotHistogram("Tile Times", renderStatistics.tileTimes.data(), static_cast<int>(renderStatistics.tileTimes.size()), 0, nullptr, 0.0f, slowestTile, ImVec2(0, 40));
+        }
+        
+        if (!renderStatistics.scheduler.busyTimes.empty()) {
+            auto [leastBusy, mostBusy] = std::minmax_element(renderStatistics.scheduler.busyTimes.begin(), renderStatistics.scheduler.busyTimes.end());
+            
+            ImGui::Text("Workers: %zu, busy %.3f-%.3fms, %u steals", renderStatistics.scheduler.busyTimes.size(), *leastBusy * 1000.0f, *mostBusy * 1000.0f, renderStatistics.scheduler.steals);
+        }
         
         if (ImGui::Button("Render")) {
             Render();
         }
         
         ImGui::Checkbox("Accumulate?", &renderer.GetSettings().accumulate);
+        ImGui::Checkbox("Reproject on Camera Move?", &renderer.GetSettings().reprojection);
+        
+        int reprojectionHistory = static_cast<int>(renderer.GetSettings().reprojectionHistory);
+        
+        if (ImGui::SliderInt("Reprojected Samples", &reprojectionHistory, 1, 256)) {
+            renderer.GetSettings().reprojectionHistory = static_cast<uint32_t>(reprojectionHistory);
+        }
+        
+        ImGui::Checkbox("Dynamic Resolution?", &renderer.GetSettings().dynamicResolution);
+        ImGui::DragFloat("Target Frame Time (ms)", &renderer.GetSettings().targetFrameTime, 0.5f, 1.0f, 1000.0f, "%.1f");
+        
+        bool renderThread = renderer.IsRenderThreadRunning();
+        
+        if (ImGui::Checkbox("Render Thread?", &renderThread)) {
+            if (renderThread) {
+                renderer.StartRenderThread();
+                renderDirty = true;
+            } else {
+                renderer.StopRenderThread();
+            }
+        }
         
         if (ImGui::Button("Reset")) {
             renderer.ResetFrameIndex();
@@ -99,6 +166,122 @@ public:
         
         ImGui::DragFloat3("Light Direction", glm::value_ptr(renderer.lightDirection), 0.1f);
         
+        const char* builderNames[] = { "SAH", "Linear (LBVH)" };
+        int builder = static_cast<int>(renderer.GetSettings().builder);
+        
+        if (ImGui::Combo("BVH Builder", &builder, builderNames, IM_ARRAYSIZE(builderNames))) {
+            renderer.GetSettings().builder = static_cast<BVH::Builder>(builder);
+            renderer.OnSceneChanged();
+            renderDirty = true;
+        }
+        
+        ImGui::DragFloat("BVH Rebuild Threshold", &renderer.GetSettings().rebuildThreshold, 0.05f, 1.0f, 10.0f);
+        
+        const char* accelerationNames[] = { "None (SIMD brute force)", "BVH", "Wide BVH" };
+        int acceleration = static_cast<int>(renderer.GetSettings().acceleration);
+        
+        if (ImGui::Combo("Acceleration", &acceleration, accelerationNames, IM_ARRAYSIZE(accelerationNames))) {
+            renderer.GetSettings().acceleration = static_cast<Renderer::Acceleration>(acceleration);
+        }
+        
+        const char* integratorNames[] = { "Per Pixel", "Wavefront" };
+        int integrator = static_cast<int>(renderer.GetSettings().integrator);
+        
+        if (ImGui::Combo("Integrator", &integrator, integratorNames, IM_ARRAYSIZE(integratorNames))) {
+            renderer.GetSettings().integrator = static_cast<Renderer::Integrator>(integrator);
+        }
+        
+        const char* samplerNames[] = { "Random", "Sobol", "Blue Noise" };
+        int sampler = static_cast<int>(renderer.GetSettings().sampler);
+        
+        // The accumulation restarts, so the new sampler's convergence can be watched from its first sample
+        if (ImGui::Combo("Sampler", &sampler, samplerNames, IM_ARRAYSIZE(samplerNames))) {
+            renderer.GetSettings().sampler = static_cast<Sampler::Type>(sampler);
+            renderer.ResetFrameIndex();
+        }
+        
+        ImGui::Checkbox("Shadow Rays?", &renderer.GetSettings().shadowRays);
+        
+        const char* lightSamplingNames[] = { "BRDF", "Light", "MIS" };
+        int lightSampling = static_cast<int>(renderer.GetSettings().lightSampling);
+        
+        if (ImGui::Combo("Light Sampling", &lightSampling, lightSamplingNames, IM_ARRAYSIZE(lightSamplingNames))) {
+            renderer.GetSettings().lightSampling = static_cast<Renderer::LightSampling>(lightSampling);
+            renderer.ResetFrameIndex();
+        }
+        
+        if (ImGui::DragFloat("Light Angle (degrees)", &renderer.GetSettings().lightAngle, 0.1f, 0.0f, 30.0f)) {
+            renderer.ResetFrameIndex();
+        }
+        
+        // An equirectangular HDR image lights the scene in place of the sky and the light
+        ImGui::InputText("Environment", environmentPath, IM_ARRAYSIZE(environmentPath));
+        
+        if (ImGui::Button("Load Environment")) {
+            LoadEnvironment();
+        }
+        
+        ImGui::SameLine();
+        
+        if (ImGui::Button("Clear Environment")) {
+            scene.environment.reset();
+            environmentError.clear();
+            renderer.ResetFrameIndex();
+            renderDirty = true;
+        }
+        
+        if (!environmentError.empty()) {
+            ImGui::TextUnformatted(environmentError.c_str());
+        } else if (scene.environment != nullptr) {
+            ImGui::Text("Environment: %ux%u", scene.environment->GetWidth(), scene.environment->GetHeight());
+        }
+        
+        if (ImGui::DragFloat("Environment Intensity", &renderer.GetSettings().environmentIntensity, 0.05f, 0.0f, 100.0f)) {
+            renderer.ResetFrameIndex();
+        }
+        
+        // Beyond the minimum, bounces are ended by Russian roulette
+        if (ImGui::DragIntRange2("Bounces", &renderer.GetSettings().minBounces, &renderer.GetSettings().maxBounces, 0.1f, 1, 64, "Min: %d", "Max: %d")) {
+            renderer.ResetFrameIndex();
+        }
+        
+        ImGui::Checkbox("Adaptive Sampling?", &renderer.GetSettings().adaptiveSampling);
+        ImGui::DragFloat("Convergence Threshold", &renderer.GetSettings().convergenceThreshold, 0.0005f, 0.0001f, 0.1f, "%.4f");
+        ImGui::Checkbox("Sample Heatmap?", &renderer.GetSettings().sampleHeatmap);
+        
+        ImGui::Checkbox("Denoise?", &renderer.GetSettings().denoise);
+        
+        int denoiseIterations = static_cast<int>(renderer.GetSettings().denoiseIterations);
+        
+        if (ImGui::SliderInt("Denoise Iterations", &denoiseIterations, 1, 8)) {
+            renderer.GetSettings().denoiseIterations = static_cast<uint32_t>(denoiseIterations);
+        }
+        
+        ImGui::Checkbox("Packet Primary Rays?", &renderer.GetSettings().packetTracing);
+        
+        bool cacheRayDirections = camera.IsCachingRayDirections();
+        
+        if (ImGui::Checkbox("Cache Ray Directions?", &cacheRayDirections)) {
+            camera.SetCacheRayDirections(cacheRayDirections, &cameraScheduler);
+            renderer.ResetFrameIndex();
+            renderDirty = true;
+        }
+        
+        int tileSize = static_cast<int>(renderer.GetSettings().tileSize);
+        
+        if (ImGui::SliderInt("Tile Size", &tileSize, 4, 128)) {
+            renderer.GetSettings().tileSize = static_cast<uint32_t>(tileSize);
+        }
+        
+        int workerCount = static_cast<int>(renderer.GetSettings().workerCount);
+        
+        if (ImGui::SliderInt("Workers (0 = all cores)", &workerCount, 0, static_cast<int>(std::thread::hardware_concurrency()))) {
+            renderer.GetSettings().workerCount = static_cast<uint32_t>(workerCount);
+        }
+        
+        ImGui::Checkbox("Pin Workers?", &renderer.GetSettings().pinWorkers);
+        ImGui::DragFloat("Frame Budget (ms, 0 = full pass)", &renderer.GetSettings().frameBudget, 0.5f, 0.0f, 1000.0f);
+        
         ImGui::End();
         
         ImGui::Begin("Scene");
@@ -108,9 +291,19 @@ public:
             
             Sphere& sphere = scene.spheres[i];
             
-            ImGui::DragFloat3("Position", glm::value_ptr(sphere.position), 0.1f);
-            ImGui::DragFloat("Radius", &sphere.radius, 0.1f);
-            ImGui::DragInt("Material", &sphere.materialIndex, 1.0f, 0, static_cast<int>(scene.materials.size() - 1));
+            bool sphereChanged = false;
+            sphereChanged |= ImGui::DragFloat3("Position", glm::value_ptr(sphere.position), 0.1f);
+            sphereChanged |= ImGui::DragFloat("Radius", &sphere.radius, 0.1f);
+            
+            if (sphereChanged) {
+                renderer.OnSphereChanged(static_cast<uint32_t>(i));
+                renderDirty = true;
+            }
+            
+            if (ImGui::DragInt("Material", &sphere.materialIndex, 1.0f, 0, static_cast<int>(scene.materials.size() - 1))) {
+                renderer.OnMaterialChanged();
+                renderDirty = true;
+            }
             
             ImGui::Separator();
             
@@ -122,9 +315,19 @@ public:
             
             Material& material = scene.materials[i];
             
-            ImGui::ColorEdit3("Albedo", glm::value_ptr(material.albedo));
-            ImGui::DragFloat("Roughness", &material.roughness, 0.05f, 0.0f, 1.0f);
-            ImGui::DragFloat("Metallic", &material.metallic, 0.05f, 0.0f, 1.0f);
+            renderDirty |= ImGui::ColorEdit3("Albedo", glm::value_ptr(material.albedo));
+            renderDirty |= ImGui::DragFloat("Roughness", &material.roughness, 0.05f, 0.0f, 1.0f);
+            renderDirty |= ImGui::DragFloat("Metallic", &material.metallic, 0.05f, 0.0f, 1.0f);
+            
+            // Emission decides which spheres are lights, and how bright
+            bool emissionChanged = false;
+            emissionChanged |= ImGui::ColorEdit3("Emission Color", glm::value_ptr(material.emissionColor));
+            emissionChanged |= ImGui::DragFloat("Emission Power", &material.emissionPower, 0.05f, 0.0f, 1000.0f);
+            
+            if (emissionChanged) {
+                renderer.OnMaterialChanged();
+                renderDirty = true;
+            }
             
             ImGui::Separator();
             
@@ -133,27 +336,279 @@ public:
         
         ImGui::End();
         
+        ImGui::Begin("Benchmark");
+        
+        ImGui::InputInt("Sphere Count", &benchmarkSphereCount, 1000, 100000);
+        benchmarkSphereCount = std::max(benchmarkSphereCount, 0);
+        
+        if (ImGui::Button("Generate Spheres")) {
+            GenerateSpheres(static_cast<uint32_t>(benchmarkSphereCount));
+        }
+        
+        ImGui::SameLine();
+        
+        if (ImGui::Button("Compare Builders")) {
+            BenchmarkBuilders();
+        }
+        
+        if (!builderResults.empty() && ImGui::BeginTable("Builders", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Builder");
+            ImGui::TableSetupColumn("Build (ms)");
+            ImGui::TableSetupColumn("Frame (ms)");
+            ImGui::TableSetupColumn("Nodes / ray");
+            ImGui::TableHeadersRow();
+            
+            for (const BuilderResult& result : builderResults) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(builderNames[static_cast<int>(result.builder)]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", result.buildTime);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", result.frameTime);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", result.nodesPerRay);
+            }
+            
+            ImGui::EndTable();
+        }
+        
+        if (ImGui::Button("Benchmark Ray Directions")) {
+            BenchmarkRayDirections();
+        }
+        
+        if (rayDirectionResult.cached > 0.0f) {
+            ImGui::Text("Cache rebuild: %.3f ms/MP", rayDirectionResult.cached);
+            ImGui::Text("Closed form, one thread: %.3f ms/MP", rayDirectionResult.closedForm);
+        }
+        
+        ImGui::End();
+        
         Render();
     }
     
+    // Replaces everything but the two initial spheres with count randomly placed small spheres
+    void GenerateSpheres(uint32_t count) {
+        scene.spheres.resize(std::min<size_t>(scene.spheres.size(), 2));
+        scene.spheres.reserve(scene.spheres.size() + count);
+        
+        float extent = std::cbrt(static_cast<float>(count)) * 1.5f;
+        
+        for (uint32_t index = 0; index < count; index += 1) {
+            Sphere sphere;
+            sphere.position = {
+                (Random::Float() * 2.0f - 1.0f) * extent,
+                Random::Float() * extent - 0.5f,
+                (Random::Float() * 2.0f - 1.0f) * extent - extent
+            };
+            sphere.radius = 0.2f + Random::Float() * 0.3f;
+            sphere.materialIndex = static_cast<int>(Random::UInt(0, static_cast<uint32_t>(scene.materials.size() - 1)));
+            
+            scene.spheres.push_back(sphere);
+        }
+        
+        renderer.OnSceneChanged();
+        renderer.ResetFrameIndex();
+        renderDirty = true;
+    }
+    
+    // Builds the BVH with every builder and renders a few frames with each, so build time can be weighed against
+    // trace speed on the current scene
+    void BenchmarkBuilders() {
+        constexpr int FrameCount = 4;
+        
+        // Frames are timed one at a time, so the render thread sits this out
+        bool renderThread = renderer.IsRenderThreadRunning();
+        renderer.StopRenderThread();
+        
+        BVH::Builder previousBuilder = renderer.GetSettings().builder;
+        builderResults.clear();
+        
+        for (BVH::Builder builder : { BVH::Builder::SAH, BVH::Builder::Linear }) {
+            renderer.GetSettings().builder = builder;
+            renderer.OnSceneChanged();
+            
+            BuilderResult& result = builderResults.emplace_back();
+            result.builder = builder;
+            
+            for (int frame = 0; frame < FrameCount; frame++) {
+                renderer.ResetFrameIndex();
+                Render();
+                
+                if (frame == 0) {
+                    result.buildTime = renderer.GetStatistics().accelerationStructure.buildTime;
+                    result.frameTime = lastRenderTime - result.buildTime;
+                } else {
+                    result.frameTime += lastRenderTime;
+                }
+                
+                result.nodesPerRay += renderer.GetStatistics().NodesPerRay();
+            }
+            
+            result.frameTime /= static_cast<float>(FrameCount);
+            result.nodesPerRay /= static_cast<float>(FrameCount);
+        }
+        
+        renderer.GetSettings().builder = previousBuilder;
+        renderer.OnSceneChanged();
+        renderer.ResetFrameIndex();
+        
+        if (renderThread) {
+            renderer.StartRenderThread();
+            renderDirty = true;
+        }
+    }
+    
+    // Times a rebuild of the ray direction cache at 4K against evaluating every closed-form direction once, which is
+    // what a frame pays instead. Both are reported per megapixel.
+    void BenchmarkRayDirections() {
+        constexpr int Iterations = 8;
+        constexpr uint32_t Width = 3840;
+        constexpr uint32_t Height = 2160;
+        
+        float megapixels = static_cast<float>(Width * Height) / 1.0e6f;
+        
+        Camera benchmarkCamera = camera;
+        benchmarkCamera.SetCacheRayDirections(false);
+        benchmarkCamera.OnResize(Width, Height);
+        benchmarkCamera.SetCacheRayDirections(true, &cameraScheduler);
+        
+        Timer timer;
+        
+        for (int iteration = 0; iteration < Iterations; iteration++) {
+            benchmarkCamera.SetView(benchmarkCamera.GetPosition(), benchmarkCamera.GetDirection());
+        }
+        
+        rayDirectionResult.cached = timer.ElapsedMillis() / static_cast<float>(Iterations) / megapixels;
+        
+        benchmarkCamera.SetCacheRayDirections(false);
+        
+        // Summed, so the directions cannot be optimized away
+        glm::vec3 sum { 0.0f };
+        timer.Reset();
+        
+        for (int iteration = 0; iteration < Iterations; iteration++) {
+            for (uint32_t y = 0; y < Height; y++) {
+                for (uint32_t x = 0; x < Width; x++) {
+                    sum += benchmarkCamera.GetRayDirection(x, y);
+                }
+            }
+        }
+        
+        rayDirectionResult.closedForm = timer.ElapsedMillis() / static_cast<float>(Iterations) / megapixels;
+        rayDirectionResult.checksum = sum.x + sum.y + sum.z;
+    }
+    
+    void LoadEnvironment() {
+        int width, height, channels;
+        float* data = stbi_loadf(environmentPath, &width, &height, &channels, 4);
+        
+        if (data == nullptr) {
+            environmentError = std::string("Could not load environment: ") + stbi_failure_reason();
+            return;
+        }
+        
+        // Building the sampling tables is a one time cost here, not per pass
+        scene.environment = std::make_shared<EnvironmentMap>(static_cast<uint32_t>(width), static_cast<uint32_t>(height), data);
+        stbi_image_free(data);
+        
+        environmentError.clear();
+        renderer.ResetFrameIndex();
+        renderDirty = true;
+    }
+    
     void Render() {
+        camera.OnResize(viewportWidth, viewportHeight);
+        
+        // The render thread works on copies, so it only needs new ones after an edit, and the UI only picks up
+        // whatever pass finished last. Frame time is then the time between finished passes.
+        if (renderer.IsRenderThreadRunning()) {
+            if (renderDirty || viewportWidth != submittedWidth || viewportHeight != submittedHeight) {
+                renderer.Submit(scene, camera, viewportWidth, viewportHeight);
+                
+                renderDirty = false;
+                submittedWidth = viewportWidth;
+                submittedHeight = viewportHeight;
+            }
+            
+            if (renderer.Present()) {
+                lastRenderTime = presentTimer.ElapsedMillis();
+                presentTimer.Reset();
+                
+                UploadImage();
+            }
+            
+            return;
+        }
+        
         Timer timer;
 
-        camera.OnResize(viewportWidth, viewportHeight);
         renderer.OnResize(viewportWidth, viewportHeight);
         
         renderer.Render(scene, camera);
         
         lastRenderTime = timer.ElapsedMillis();
+        
+        UploadImage();
+    }
+    
+    void UploadImage() {
+        const Framebuffer& framebuffer = renderer.GetFinalImage();
+        
+        if (framebuffer.width == 0 || framebuffer.height == 0) {
+            return;
+        }
+        
+        if (image == nullptr) {
+            image = std::make_shared<Image>(framebuffer.width, framebuffer.height, ImageFormat::RGBA);
+        } else if (image->GetWidth() != framebuffer.width || image->GetHeight() != framebuffer.height) {
+            image->Resize(framebuffer.width, framebuffer.height);
+        }
+        
+        image->SetData(framebuffer.pixels.data());
     }
     
 private:
+    
+    struct BuilderResult {
+        BVH::Builder builder = BVH::Builder::SAH;
+        float buildTime = 0.0f;
+        float frameTime = 0.0f;
+        float nodesPerRay = 0.0f;
+    };
+    
+    struct RayDirectionResult {
+        float cached = 0.0f;
+        float closedForm = 0.0f;
+        float checksum = 0.0f;
+    };
+    
+    // Rebuilds the camera's ray direction cache. The render thread can be using the renderer's workers whenever the
+    // camera moves, so the cache gets workers of its own.
+    TileScheduler cameraScheduler;
+    
     Camera camera;
     Renderer renderer;
     Scene scene;
+    
+    // The renderer's final image, uploaded for the viewport
+    std::shared_ptr<Image> image;
     uint32_t viewportWidth = 0, viewportHeight = 0;
     
     float lastRenderTime = 0.0f;
+    
+    // Set by any edit the render thread has not been given yet
+    bool renderDirty = true;
+    uint32_t submittedWidth = 0, submittedHeight = 0;
+    Timer presentTimer;
+    
+    char environmentPath[1024] = "";
+    std::string environmentError;
+    
+    int benchmarkSphereCount = 50000;
+    std::vector<BuilderResult> builderResults;
+    
+    RayDirectionResult rayDirectionResult;
 };
 
 Walnut::Application* Walnut::CreateApplication(int argc, char** argv) {
@@ -0,0 +1,368 @@
+//
+//  WideBVH.cpp
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#include "WideBVH.h"
+
+#include "SIMD.h"
+
+#include <algorithm>
+
+namespace Utils {
+
+    // Each level of the wide tree can push up to three siblings on top of the one being descended into
+    static constexpr uint32_t StackSize = 256;
+}
+
+void WideBVH::Build(const BVH& bvh) {
+    Clear();
+
+    if (bvh.IsEmpty()) {
+        return;
+    }
+
+    primitiveIndices = bvh.GetPrimitiveIndices();
+    primitiveSlots.resize(primitiveIndices.size());
+
+    // Every wide node absorbs at least one binary interior node, so this is an upper bound
+    nodes.reserve(bvh.GetNodes().size() / 2 + 1);
+
+    Collapse(bvh, 0, InvalidIndex, 0);
+}
+
+void WideBVH::Clear() {
+    nodes.clear();
+    primitiveIndices.clear();
+    parents.clear();
+    parentSlots.clear();
+    primitiveSlots.clear();
+}
+
+uint32_t WideBVH::Collapse(const BVH& bvh, uint32_t binaryIndex, uint32_t parent, uint32_t parentSlot) {
+    const std::vector<BVH::Node>& binaryNodes = bvh.GetNodes();
+
+    uint32_t nodeIndex = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    parents.push_back(parent);
+    parentSlots.push_back(parentSlot);
+
+    // Gather up to four binary descendants, repeatedly opening the interior candidate with the largest surface area,
+    // since that is the one most rays would have had to descend into anyway
+    uint32_t candidates[Width];
+    int candidateCount = 0;
+
+    if (binaryNodes[binaryIndex].IsLeaf()) {
+        candidates[candidateCount++] = binaryIndex;
+    } else {
+        candidates[candidateCount++] = binaryNodes[binaryIndex].leftFirst;
+        candidates[candidateCount++] = binaryNodes[binaryIndex].leftFirst + 1;
+    }
+
+    while (candidateCount < Width) {
+        int best = -1;
+        float bestArea = -1.0f;
+
+        for (int index = 0; index < candidateCount; index++) {
+            const BVH::Node& candidate = binaryNodes[candidates[index]];
+
+            if (candidate.IsLeaf()) {
+                continue;
+            }
+
+            float area = AABB { candidate.boundsMin, candidate.boundsMax }.Area();
+
+            if (area > bestArea) {
+                best = index;
+                bestArea = area;
+            }
+        }
+
+        if (best == -1) {
+            break;
+        }
+
+        uint32_t opened = candidates[best];
+        candidates[best] = binaryNodes[opened].leftFirst;
+        candidates[candidateCount++] = binaryNodes[opened].leftFirst + 1;
+    }
+
+    glm::vec3 centers[Width];
+
+    for (int slot = 0; slot < Width; slot++) {
+        if (slot >= candidateCount) {
+            Node& node = nodes[nodeIndex];
+            SetSlotBounds(node, slot, AABB());
+            node.children[slot] = InvalidIndex;
+            node.counts[slot] = 0;
+
+            continue;
+        }
+
+        const BVH::Node& candidate = binaryNodes[candidates[slot]];
+        centers[slot] = (candidate.boundsMin + candidate.boundsMax) * 0.5f;
+
+        uint32_t child = candidate.leftFirst;
+        uint32_t count = candidate.primitiveCount;
+
+        if (candidate.IsLeaf()) {
+            for (uint32_t index = 0; index < count; index += 1) {
+                primitiveSlots[primitiveIndices[child + index]] = nodeIndex * Width + slot;
+            }
+        } else {
+            // Recursing appends nodes, so look the node up again afterwards rather than holding a reference
+            child = Collapse(bvh, candidates[slot], nodeIndex, slot);
+        }
+
+        Node& node = nodes[nodeIndex];
+        SetSlotBounds(node, slot, AABB { candidate.boundsMin, candidate.boundsMax });
+        node.children[slot] = child;
+        node.counts[slot] = count;
+    }
+
+    // Precompute a front-to-back order for each direction octant by sorting the child centers along the octant's
+    // diagonal. Traversal then orders children with a table lookup on the ray's direction signs instead of a sort.
+    Node& node = nodes[nodeIndex];
+
+    for (int octant = 0; octant < 8; octant++) {
+        glm::vec3 direction = {
+            (octant & 1) ? -1.0f : 1.0f,
+            (octant & 2) ? -1.0f : 1.0f,
+            (octant & 4) ? -1.0f : 1.0f
+        };
+
+        int slots[Width] = { 0, 1, 2, 3 };
+
+        std::sort(slots, slots + candidateCount, [&](int lhs, int rhs) {
+            return glm::dot(centers[lhs], direction) < glm::dot(centers[rhs], direction);
+        });
+
+        node.order[octant] = static_cast<uint8_t>(slots[0] | (slots[1] << 2) | (slots[2] << 4) | (slots[3] << 6));
+    }
+
+    node.childCount = static_cast<uint8_t>(candidateCount);
+
+    return nodeIndex;
+}
+
+void WideBVH::Refit(const std::vector<Sphere>& spheres, const std::vector<uint32_t>& dirtyPrimitives) {
+    for (uint32_t primitive : dirtyPrimitives) {
+        if (primitive >= primitiveSlots.size()) {
+            continue;
+        }
+
+        uint32_t nodeIndex = primitiveSlots[primitive] / Width;
+        int slot = static_cast<int>(primitiveSlots[primitive] % Width);
+
+        const Node& leafNode = nodes[nodeIndex];
+        AABB bounds;
+
+        for (uint32_t index = 0; index < leafNode.counts[slot]; index += 1) {
+            bounds.Grow(AABB::FromSphere(spheres[primitiveIndices[leafNode.children[slot] + index]]));
+        }
+
+        // Walk towards the root, stopping as soon as a slot's bounds are unchanged
+        while (true) {
+            Node& node = nodes[nodeIndex];
+            AABB previous = SlotBounds(node, slot);
+
+            if (previous.min == bounds.min && previous.max == bounds.max) {
+                break;
+            }
+
+            SetSlotBounds(node, slot, bounds);
+
+            if (nodeIndex == 0) {
+                break;
+            }
+
+            bounds = AABB();
+
+            for (int index = 0; index < node.childCount; index++) {
+                bounds.Grow(SlotBounds(node, index));
+            }
+
+            slot = static_cast<int>(parentSlots[nodeIndex]);
+            nodeIndex = parents[nodeIndex];
+        }
+    }
+}
+
+bool WideBVH::Intersect(const Ray& ray, const SphereSoA& spheres, float& hitDistance, int& objectIndex, uint32_t& nodesVisited) const {
+    using namespace SIMD;
+
+    if (nodes.empty()) {
+        return false;
+    }
+
+    glm::vec3 inverseDirection = 1.0f / ray.direction;
+
+    Float4 originX = Float4::Splat(ray.origin.x);
+    Float4 originY = Float4::Splat(ray.origin.y);
+    Float4 originZ = Float4::Splat(ray.origin.z);
+
+    Float4 inverseX = Float4::Splat(inverseDirection.x);
+    Float4 inverseY = Float4::Splat(inverseDirection.y);
+    Float4 inverseZ = Float4::Splat(inverseDirection.z);
+
+    Float4 zero = Float4::Splat(0.0f);
+
+    int octant = (ray.direction.x < 0.0f ? 1 : 0) | (ray.direction.y < 0.0f ? 2 : 0) | (ray.direction.z < 0.0f ? 4 : 0);
+
+    struct StackEntry {
+        uint32_t index;
+        uint32_t count;
+        float distance;
+    };
+
+    StackEntry stack[Utils::StackSize];
+    uint32_t stackSize = 0;
+
+    stack[stackSize++] = { 0, 0, 0.0f };
+
+    bool hit = false;
+
+    while (stackSize > 0) {
+        StackEntry entry = stack[--stackSize];
+
+        // Something closer was found after this entry was pushed
+        if (entry.distance > hitDistance) {
+            continue;
+        }
+
+        if (entry.count > 0) {
+            hit |= spheres.Intersect(ray, entry.index, entry.count, hitDistance, objectIndex);
+
+            continue;
+        }
+
+        const Node& node = nodes[entry.index];
+        nodesVisited += 1;
+
+        // Slab test against all four children at once
+        Float4 t0X = (Float4::Load(node.minX) - originX) * inverseX;
+        Float4 t0Y = (Float4::Load(node.minY) - originY) * inverseY;
+        Float4 t0Z = (Float4::Load(node.minZ) - originZ) * inverseZ;
+        Float4 t1X = (Float4::Load(node.maxX) - originX) * inverseX;
+        Float4 t1Y = (Float4::Load(node.maxY) - originY) * inverseY;
+        Float4 t1Z = (Float4::Load(node.maxZ) - originZ) * inverseZ;
+
+        Float4 tNear = Max(Max(Min(t0X, t1X), Min(t0Y, t1Y)), Max(Min(t0Z, t1Z), zero));
+        Float4 tFar = Min(Min(Max(t0X, t1X), Max(t0Y, t1Y)), Min(Max(t0Z, t1Z), Float4::Splat(hitDistance)));
+
+        int hitMask = MoveMask(LessEqual(tNear, tFar)) & ((1 << node.childCount) - 1);
+
+        if (hitMask == 0) {
+            continue;
+        }
+
+        alignas(16) float distances[Width];
+        tNear.Store(distances);
+
+        // Push far to near, so the nearest child is popped next
+        uint8_t order = node.order[octant];
+
+        for (int index = Width - 1; index >= 0; index--) {
+            int slot = (order >> (index * 2)) & 0x3;
+
+            if (hitMask & (1 << slot)) {
+                stack[stackSize++] = { node.children[slot], node.counts[slot], distances[slot] };
+            }
+        }
+    }
+
+    return hit;
+}
+
+bool WideBVH::Occluded(const Ray& ray, const SphereSoA& spheres, float maxDistance, uint32_t& nodesVisited) const {
+    using namespace SIMD;
+
+    if (nodes.empty()) {
+        return false;
+    }
+
+    glm::vec3 inverseDirection = 1.0f / ray.direction;
+
+    Float4 originX = Float4::Splat(ray.origin.x);
+    Float4 originY = Float4::Splat(ray.origin.y);
+    Float4 originZ = Float4::Splat(ray.origin.z);
+
+    Float4 inverseX = Float4::Splat(inverseDirection.x);
+    Float4 inverseY = Float4::Splat(inverseDirection.y);
+    Float4 inverseZ = Float4::Splat(inverseDirection.z);
+
+    Float4 zero = Float4::Splat(0.0f);
+    Float4 limit = Float4::Splat(maxDistance);
+
+    // Entries are nodes, or leaf ranges when count is above 0. No distances, since nothing is culled by them.
+    struct StackEntry {
+        uint32_t index;
+        uint32_t count;
+    };
+
+    StackEntry stack[Utils::StackSize];
+    uint32_t stackSize = 0;
+
+    stack[stackSize++] = { 0, 0 };
+
+    while (stackSize > 0) {
+        StackEntry entry = stack[--stackSize];
+
+        if (entry.count > 0) {
+            if (spheres.Occluded(ray, entry.index, entry.count, maxDistance)) {
+                return true;
+            }
+
+            continue;
+        }
+
+        const Node& node = nodes[entry.index];
+        nodesVisited += 1;
+
+        Float4 t0X = (Float4::Load(node.minX) - originX) * inverseX;
+        Float4 t0Y = (Float4::Load(node.minY) - originY) * inverseY;
+        Float4 t0Z = (Float4::Load(node.minZ) - originZ) * inverseZ;
+        Float4 t1X = (Float4::Load(node.maxX) - originX) * inverseX;
+        Float4 t1Y = (Float4::Load(node.maxY) - originY) * inverseY;
+        Float4 t1Z = (Float4::Load(node.maxZ) - originZ) * inverseZ;
+
+        Float4 tNear = Max(Max(Min(t0X, t1X), Min(t0Y, t1Y)), Max(Min(t0Z, t1Z), zero));
+        Float4 tFar = Min(Min(Max(t0X, t1X), Max(t0Y, t1Y)), Min(Max(t0Z, t1Z), limit));
+
+        int hitMask = MoveMask(LessEqual(tNear, tFar)) & ((1 << node.childCount) - 1);
+
+        // Leaves first, so a hit ends the query before any more nodes are fetched
+        for (int slot = 0; slot < Width; slot++) {
+            if ((hitMask & (1 << slot)) && node.counts[slot] == 0) {
+                stack[stackSize++] = { node.children[slot], 0 };
+            }
+        }
+
+        for (int slot = 0; slot < Width; slot++) {
+            if ((hitMask & (1 << slot)) && node.counts[slot] > 0) {
+                stack[stackSize++] = { node.children[slot], node.counts[slot] };
+            }
+        }
+    }
+
+    return false;
+}
+
+AABB WideBVH::SlotBounds(const Node& node, int slot) const {
+    AABB bounds;
+    bounds.min = { node.minX[slot], node.minY[slot], node.minZ[slot] };
+    bounds.max = { node.maxX[slot], node.maxY[slot], node.maxZ[slot] };
+
+    return bounds;
+}
+
+void WideBVH::SetSlotBounds(Node& node, int slot, const AABB& bounds) {
+    node.minX[slot] = bounds.min.x;
+    node.minY[slot] = bounds.min.y;
+    node.minZ[slot] = bounds.min.z;
+    node.maxX[slot] = bounds.max.x;
+    node.maxY[slot] = bounds.max.y;
+    node.maxZ[slot] = bounds.max.z;
+}
@@ -0,0 +1,77 @@
+//
+//  WideBVH.h
+//  RayTracing
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#pragma once
+
+#include "BVH.h"
+
+#include <vector>
+
+// A 4-ary BVH collapsed from a binary BVH. Each node keeps the bounds of its four children in structure-of-arrays
+// form so one SIMD slab test covers all of them, and one node fetch replaces up to three binary node fetches.
+class WideBVH {
+
+public:
+
+    static constexpr int Width = 4;
+    static constexpr uint32_t InvalidIndex = 0xFFFFFFFF;
+
+    struct alignas(16) Node {
+        float minX[Width];
+        float minY[Width];
+        float minZ[Width];
+        float maxX[Width];
+        float maxY[Width];
+        float maxZ[Width];
+
+        uint32_t children[Width]; // Child node for interior slots, first primitive for leaf slots
+        uint32_t counts[Width];   // 0 for interior slots, primitive count for leaf slots
+
+        // Front-to-back child order for each ray direction octant, 2 bits per slot, nearest slot in the low bits
+        uint8_t order[8];
+
+        // Slots [0, childCount) are in use
+        uint8_t childCount;
+    };
+
+public:
+
+    WideBVH() = default;
+
+    // Collapses the binary tree. Uses the binary tree's primitive order, so leaves reference the same primitives.
+    void Build(const BVH& bvh);
+    void Clear();
+
+    // Updates the bounds on the path from each primitive's leaf to the root, keeping the topology
+    void Refit(const std::vector<Sphere>& spheres, const std::vector<uint32_t>& dirtyPrimitives);
+
+    // Same contract as BVH::Intersect. The spheres must be stored in the source BVH's primitive order.
+    bool Intersect(const Ray& ray, const SphereSoA& spheres, float& hitDistance, int& objectIndex, uint32_t& nodesVisited) const;
+
+    // Same contract as BVH::Occluded
+    bool Occluded(const Ray& ray, const SphereSoA& spheres, float maxDistance, uint32_t& nodesVisited) const;
+
+    bool IsEmpty() const { return nodes.empty(); }
+    size_t GetNodeCount() const { return nodes.size(); }
+
+private:
+
+    uint32_t Collapse(const BVH& bvh, uint32_t binaryIndex, uint32_t parent, uint32_t parentSlot);
+
+    AABB SlotBounds(const Node& node, int slot) const;
+    void SetSlotBounds(Node& node, int slot, const AABB& bounds);
+
+private:
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> primitiveIndices;
+
+    // Links used by Refit: each node's parent and its slot there, and the node and slot holding each primitive
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> parentSlots;
+    std::vector<uint32_t> primitiveSlots;
+};
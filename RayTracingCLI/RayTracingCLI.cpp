@@ -0,0 +1,974 @@
+//
+//  RayTracingCLI.cpp
+//  RayTracingCLI
+//
+//  Created by Stephen H. Gerstacker on 2026-10-17.
+//
+
+#include <Walnut/Timer.h>
+
+#include "BRDF.h"
+#include "BVH.h"
+#include "Camera.h"
+#include "RandomSequence.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "SphereSoA.h"
+#include "WideBVH.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Walnut;
+
+namespace Utils {
+
+    static constexpr float Pi = 3.14159265358979f;
+
+    struct Options {
+        uint32_t width = 1280;
+        uint32_t height = 720;
+        uint32_t samples = 64;
+
+        std::string scenePath;
+        std::string environmentPath;
+        uint32_t randomSpheres = 0;
+        uint32_t emissiveSpheres = 0;
+        std::string outputPath = "render.png";
+
+        // Above 0, compares the samplers, the light sampling strategies, the denoiser or adaptive sampling instead of
+        // writing an image
+        float convergenceTarget = 0.0f;
+        std::string compare = "samplers";
+
+        // Above 0, compares how the accumulation recovers from this many camera moves instead of writing an image
+        uint32_t motionSteps = 0;
+
+        // When set, checks one of the renderer's building blocks against a slower reference instead of rendering
+        std::string validate;
+
+        glm::vec3 position { 0.0f, 0.0f, 6.0f };
+        glm::vec3 direction { 0.0f, 0.0f, -1.0f };
+        glm::vec3 lightDirection { -1.0f, -1.0f, -1.0f };
+
+        Renderer::Settings settings;
+    };
+
+    static void PrintUsage(const char* program) {
+        printf("Usage: %s [options]\n", program);
+        printf("\n");
+        printf("  --width <pixels>          Image width (default 1280)\n");
+        printf("  --height <pixels>         Image height (default 720)\n");
+        printf("  --samples <count>         Samples per pixel (default 64)\n");
+        printf("  --scene <path>            Scene file (default: the application's two sphere scene)\n");
+        printf("  --random-spheres <count>  Adds randomly placed spheres, like the application's benchmark\n");
+        printf("  --emissive-spheres <count>  Makes this many of the random spheres glow, lighting the scene\n");
+        printf("  --output <path>           .png, .bmp, .tga or .ppm (default render.png)\n");
+        printf("  --position <x,y,z>        Camera position (default 0,0,6)\n");
+        printf("  --direction <x,y,z>       Camera direction (default 0,0,-1)\n");
+        printf("  --workers <count>         Render threads, 0 for one per core (default 0)\n");
+        printf("  --pin-workers             Pins each render thread to a core\n");
+        printf("  --builder <sah|linear>    BVH builder (default sah)\n");
+        printf("  --integrator <pixel|wavefront>\n");
+        printf("  --sampler <random|sobol|bluenoise>\n");
+        printf("  --seed <value>            Sampler seed (default 0)\n");
+        printf("  --no-shadows              Lights surfaces facing the light without testing for occluders\n");
+        printf("  --min-bounces <count>     Bounces before Russian roulette may end a path (default 3)\n");
+        printf("  --max-bounces <count>     Bounces at which every path ends (default 8)\n");
+        printf("  --adaptive <error>        Stops sampling tiles once the standard error of every pixel is below this,\n");
+        printf("                            so --samples becomes the most any pixel gets\n");
+        printf("  --heatmap                 Writes the samples per pixel instead of the image\n");
+        printf("  --denoise <iterations>    Filters the image with this many iterations of the edge-aware denoiser\n");
+        printf("  --convergence <rms error> Reports the samples and time each sampler needs to get within this RMS\n");
+        printf("                            error of a reference with 4x the samples, instead of writing an image\n");
+        printf("  --compare <samplers|lighting|denoiser|adaptive>  What --convergence compares (default samplers).\n");
+        printf("                            adaptive compares uniform sampling with --adaptive's threshold (default\n");
+        printf("                            0.005), in samples per pixel on average\n");
+        printf("  --motion <steps>          Settles --samples samples, then pans the camera this many times, one pass\n");
+        printf("                            per step, and reports the error at the end with and without reprojection\n");
+        printf("                            and dynamic resolution\n");
+        printf("  --target-frame-time <ms>  Pass time dynamic resolution aims for while the camera moves (default 33)\n");
+        printf("  --validate <occlusion|brdf>  occlusion checks the any-hit shadow queries against the closest hit,\n");
+        printf("                            with every acceleration structure, and reports the nodes visited per ray.\n");
+        printf("                            brdf checks the BRDF's sample weights and densities against integrating\n");
+        printf("                            it over the hemisphere.\n");
+        printf("  --light-direction <x,y,z> Direction the light travels (default -1,-1,-1)\n");
+        printf("  --light-angle <degrees>   Angular diameter of the light, 0 for a point-like light (default 1)\n");
+        printf("  --light-sampling <brdf|light|mis>\n");
+        printf("  --environment <path>      Equirectangular HDR image that lights the scene instead of the sky and the\n");
+        printf("                            light\n");
+        printf("  --environment-intensity <scale>  Scales the environment's radiance (default 1)\n");
+        printf("\n");
+        printf("Scene files have one entry per line, and # starts a comment:\n");
+        printf("  material <r> <g> <b> <roughness> [metallic] [emission power]\n");
+        printf("  sphere <x> <y> <z> <radius> <material index>\n");
+    }
+
+    static bool ParseVec3(const char* text, glm::vec3& value) {
+        return sscanf(text, "%f,%f,%f", &value.x, &value.y, &value.z) == 3;
+    }
+
+    static bool ParseOptions(int argc, char** argv, Options& options) {
+        for (int index = 1; index < argc; index++) {
+            std::string option = argv[index];
+
+            if (option == "--help" || option == "-h") {
+                return false;
+            }
+
+            if (option == "--pin-workers") {
+                options.settings.pinWorkers = true;
+                continue;
+            }
+
+            if (option == "--heatmap") {
+                options.settings.sampleHeatmap = true;
+                continue;
+            }
+
+            if (option == "--no-shadows") {
+                options.settings.shadowRays = false;
+                continue;
+            }
+
+            static const char* valueOptions[] = {
+                "--width", "--height", "--samples", "--scene", "--random-spheres", "--emissive-spheres", "--output",
+                "--position", "--direction", "--workers", "--builder", "--integrator", "--sampler", "--seed",
+                "--convergence", "--min-bounces", "--max-bounces", "--adaptive",
+                "--compare", "--light-direction", "--light-angle", "--light-sampling",
+                "--environment", "--environment-intensity", "--denoise", "--motion",
+                "--target-frame-time", "--validate"
+            };
+
+            auto isValueOption = [&option](const char* valueOption) { return option == valueOption; };
+
+            if (std::none_of(std::begin(valueOptions), std::end(valueOptions), isValueOption)) {
+                fprintf(stderr, "Unknown option: %s\n", option.c_str());
+                return false;
+            }
+
+            if (index + 1 >= argc) {
+                fprintf(stderr, "Missing value for %s\n", option.c_str());
+                return false;
+            }
+
+            const char* value = argv[++index];
+
+            if (option == "--width") {
+                options.width = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            } else if (option == "--height") {
+                options.height = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            } else if (option == "--samples") {
+                options.samples = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            } else if (option == "--scene") {
+                options.scenePath = value;
+            } else if (option == "--random-spheres") {
+                options.randomSpheres = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            } else if (option == "--emissive-spheres") {
+                options.emissiveSpheres = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            } else if (option == "--output") {
+                options.outputPath = value;
+            } else if (option == "--position") {
+                if (!ParseVec3(value, options.position)) {
+                    fprintf(stderr, "Invalid position: %s\n", value);
+                    return false;
+                }
+            } else if (option == "--direction") {
+                if (!ParseVec3(value, options.direction) || glm::length(options.direction) == 0.0f) {
+                    fprintf(stderr, "Invalid direction: %s\n", value);
+                    return false;
+                }
+            } else if (option == "--workers") {
+                options.settings.workerCount = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            } else if (option == "--builder") {
+                if (strcmp(value, "sah") == 0) {
+                    options.settings.builder = BVH::Builder::SAH;
+                } else if (strcmp(value, "linear") == 0) {
+                    options.settings.builder = BVH::Builder::Linear;
+                } else {
+                    fprintf(stderr, "Unknown builder: %s\n", value);
+                    return false;
+                }
+            } else if (option == "--integrator") {
+                if (strcmp(value, "pixel") == 0) {
+                    options.settings.integrator = Renderer::Integrator::PerPixel;
+                } else if (strcmp(value, "wavefront") == 0) {
+                    options.settings.integrator = Renderer::Integrator::Wavefront;
+                } else {
+                    fprintf(stderr, "Unknown integrator: %s\n", value);
+                    return false;
+                }
+            } else if (option == "--sampler") {
+                if (strcmp(value, "random") == 0) {
+                    options.settings.sampler = Sampler::Type::Random;
+                } else if (strcmp(value, "sobol") == 0) {
+                    options.settings.sampler = Sampler::Type::Sobol;
+                } else if (strcmp(value, "bluenoise") == 0) {
+                    options.settings.sampler = Sampler::Type::BlueNoise;
+                } else {
+                    fprintf(stderr, "Unknown sampler: %s\n", value);
+                    return false;
+                }
+            } else if (option == "--seed") {
+                options.settings.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            } else if (option == "--compare") {
+                if (strcmp(value, "samplers") != 0 && strcmp(value, "lighting") != 0 && strcmp(value, "denoiser") != 0 && strcmp(value, "adaptive") != 0) {
+                    fprintf(stderr, "Unknown comparison: %s\n", value);
+                    return false;
+                }
+
+                options.compare = value;
+            } else if (option == "--light-direction") {
+                if (!ParseVec3(value, options.lightDirection) || glm::length(options.lightDirection) == 0.0f) {
+                    fprintf(stderr, "Invalid light direction: %s\n", value);
+                    return false;
+                }
+            } else if (option == "--light-angle") {
+                options.settings.lightAngle = std::strtof(value, nullptr);
+            } else if (option == "--light-sampling") {
+                if (strcmp(value, "brdf") == 0) {
+                    options.settings.lightSampling = Renderer::LightSampling::BRDF;
+                } else if (strcmp(value, "light") == 0) {
+                    options.settings.lightSampling = Renderer::LightSampling::Light;
+                } else if (strcmp(value, "mis") == 0) {
+                    options.settings.lightSampling = Renderer::LightSampling::MultipleImportance;
+                } else {
+                    fprintf(stderr, "Unknown light sampling: %s\n", value);
+                    return false;
+                }
+            } else if (option == "--environment") {
+                options.environmentPath = value;
+            } else if (option == "--environment-intensity") {
+                options.settings.environmentIntensity = std::strtof(value, nullptr);
+            } else if (option == "--denoise") {
+                options.settings.denoise = true;
+                options.settings.denoiseIterations = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            } else if (option == "--adaptive") {
+                options.settings.adaptiveSampling = true;
+                options.settings.convergenceThreshold = std::strtof(value, nullptr);
+            } else if (option == "--min-bounces") {
+                options.settings.minBounces = static_cast<int>(std::strtol(value, nullptr, 10));
+            } else if (option == "--max-bounces") {
+                options.settings.maxBounces = static_cast<int>(std::strtol(value, nullptr, 10));
+            } else if (option == "--convergence") {
+                options.convergenceTarget = std::strtof(value, nullptr);
+            } else if (option == "--motion") {
+                options.motionSteps = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+            } else if (option == "--target-frame-time") {
+                options.settings.targetFrameTime = std::strtof(value, nullptr);
+            } else if (option == "--validate") {
+                if (strcmp(value, "occlusion") != 0 && strcmp(value, "brdf") != 0) {
+                    fprintf(stderr, "Unknown validation: %s\n", value);
+                    return false;
+                }
+
+                options.validate = value;
+            }
+        }
+
+        if (options.width == 0 || options.height == 0 || options.samples == 0) {
+            fprintf(stderr, "Width, height and samples must be greater than 0\n");
+            return false;
+        }
+
+        if (options.emissiveSpheres > options.randomSpheres) {
+            fprintf(stderr, "Only random spheres can be emissive, and there are %u\n", options.randomSpheres);
+            return false;
+        }
+
+        return true;
+    }
+
+    // The scene the application starts with
+    static void CreateDefaultScene(Scene& scene) {
+        Material& pinkSphere = scene.materials.emplace_back();
+        pinkSphere.albedo = { 1.0f, 0.0f, 1.0f };
+        pinkSphere.roughness = 0.0f;
+
+        Material& blueSphere = scene.materials.emplace_back();
+        blueSphere.albedo = { 0.2f, 0.3f, 1.0f };
+        blueSphere.roughness = 0.1f;
+
+        Sphere& sphere = scene.spheres.emplace_back();
+        sphere.position = { 0.0f, 0.0f, 0.0f };
+        sphere.radius = 1.0f;
+        sphere.materialIndex = 0;
+
+        Sphere& ground = scene.spheres.emplace_back();
+        ground.position = { 0.0f, -101.0f, 0.0f };
+        ground.radius = 100.0f;
+        ground.materialIndex = 1;
+    }
+
+    static bool LoadScene(const std::string& path, Scene& scene) {
+        std::ifstream file(path);
+
+        if (!file.is_open()) {
+            fprintf(stderr, "Could not open %s\n", path.c_str());
+            return false;
+        }
+
+        std::string line;
+        uint32_t lineNumber = 0;
+
+        while (std::getline(file, line)) {
+            lineNumber += 1;
+
+            size_t comment = line.find('#');
+
+            if (comment != std::string::npos) {
+                line.erase(comment);
+            }
+
+            std::istringstream stream(line);
+            std::string kind;
+
+            if (!(stream >> kind)) {
+                continue;
+            }
+
+            if (kind == "material") {
+                Material material;
+
+                if (!(stream >> material.albedo.r >> material.albedo.g >> material.albedo.b >> material.roughness)) {
+                    fprintf(stderr, "%s:%u: expected material <r> <g> <b> <roughness> [metallic] [emission power]\n", path.c_str(), lineNumber);
+                    return false;
+                }
+
+                // Emissive materials glow in their albedo color
+                stream >> material.metallic >> material.emissionPower;
+                material.emissionColor = material.albedo;
+                scene.materials.push_back(material);
+            } else if (kind == "sphere") {
+                Sphere sphere;
+
+                if (!(stream >> sphere.position.x >> sphere.position.y >> sphere.position.z >> sphere.radius >> sphere.materialIndex)) {
+                    fprintf(stderr, "%s:%u: expected sphere <x> <y> <z> <radius> <material index>\n", path.c_str(), lineNumber);
+                    return false;
+                }
+
+                scene.spheres.push_back(sphere);
+            } else {
+                fprintf(stderr, "%s:%u: unknown entry %s\n", path.c_str(), lineNumber, kind.c_str());
+                return false;
+            }
+        }
+
+        for (const Sphere& sphere : scene.spheres) {
+            if (sphere.materialIndex < 0 || sphere.materialIndex >= static_cast<int>(scene.materials.size())) {
+                fprintf(stderr, "%s: sphere uses material %d, but there are %zu materials\n", path.c_str(), sphere.materialIndex, scene.materials.size());
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static bool LoadEnvironment(const std::string& path, Scene& scene) {
+        int width, height, channels;
+        float* data = stbi_loadf(path.c_str(), &width, &height, &channels, 4);
+
+        if (data == nullptr) {
+            fprintf(stderr, "Could not load %s: %s\n", path.c_str(), stbi_failure_reason());
+            return false;
+        }
+
+        scene.environment = std::make_shared<EnvironmentMap>(static_cast<uint32_t>(width), static_cast<uint32_t>(height), data);
+        stbi_image_free(data);
+
+        return true;
+    }
+
+    // Same distribution as the application's benchmark spheres, but from a fixed sequence, so every run and every
+    // platform gets the same scene
+    // The first emissiveCount spheres share one glowing material. They are placed at random like the others, so
+    // they are a random subset of them.
+    static void GenerateSpheres(Scene& scene, uint32_t count, uint32_t emissiveCount) {
+        if (scene.materials.empty()) {
+            scene.materials.emplace_back();
+        }
+
+        uint32_t materialCount = static_cast<uint32_t>(scene.materials.size());
+
+        if (emissiveCount > 0) {
+            Material& light = scene.materials.emplace_back();
+            light.albedo = { 1.0f, 0.85f, 0.6f };
+            light.emissionColor = light.albedo;
+            light.emissionPower = 5.0f;
+        }
+
+        scene.spheres.reserve(scene.spheres.size() + count);
+
+        float extent = std::cbrt(static_cast<float>(count)) * 1.5f;
+        RandomSequence random;
+
+        for (uint32_t index = 0; index < count; index += 1) {
+            Sphere sphere;
+            sphere.position = {
+                (random.Float() * 2.0f - 1.0f) * extent,
+                random.Float() * extent - 0.5f,
+                (random.Float() * 2.0f - 1.0f) * extent - extent
+            };
+            sphere.radius = 0.2f + random.Float() * 0.3f;
+            sphere.materialIndex = static_cast<int>(random.UInt() % materialCount);
+
+            if (index < emissiveCount) {
+                sphere.materialIndex = static_cast<int>(materialCount);
+            }
+
+            scene.spheres.push_back(sphere);
+        }
+    }
+
+    static bool HasExtension(const std::string& path, const char* extension) {
+        size_t length = strlen(extension);
+
+        return path.size() >= length && path.compare(path.size() - length, length, extension) == 0;
+    }
+
+    static bool WriteImage(const std::string& path, const Framebuffer& framebuffer) {
+        int width = static_cast<int>(framebuffer.width);
+        int height = static_cast<int>(framebuffer.height);
+
+        // The framebuffer starts with the bottom row, image files with the top one
+        std::vector<uint32_t> pixels(framebuffer.pixels.size());
+
+        for (int y = 0; y < height; y++) {
+            memcpy(&pixels[y * width], &framebuffer.pixels[(height - 1 - y) * width], width * sizeof(uint32_t));
+        }
+
+        if (HasExtension(path, ".png")) {
+            return stbi_write_png(path.c_str(), width, height, 4, pixels.data(), width * 4) != 0;
+        } else if (HasExtension(path, ".bmp")) {
+            return stbi_write_bmp(path.c_str(), width, height, 4, pixels.data()) != 0;
+        } else if (HasExtension(path, ".tga")) {
+            return stbi_write_tga(path.c_str(), width, height, 4, pixels.data()) != 0;
+        } else if (HasExtension(path, ".ppm")) {
+            FILE* file = fopen(path.c_str(), "wb");
+
+            if (file == nullptr) {
+                return false;
+            }
+
+            fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+            for (uint32_t pixel : pixels) {
+                uint8_t rgb[3] = { static_cast<uint8_t>(pixel), static_cast<uint8_t>(pixel >> 8), static_cast<uint8_t>(pixel >> 16) };
+                fwrite(rgb, 1, 3, file);
+            }
+
+            return fclose(file) == 0;
+        }
+
+        fprintf(stderr, "Unsupported image format: %s\n", path.c_str());
+
+        return false;
+    }
+
+    static float RMSError(const Framebuffer& image, const Framebuffer& reference) {
+        double sum = 0.0;
+
+        for (size_t index = 0; index < image.pixels.size(); index++) {
+            for (int channel = 0; channel < 3; channel++) {
+                float value = static_cast<float>((image.pixels[index] >> (channel * 8)) & 0xFF) / 255.0f;
+                float expected = static_cast<float>((reference.pixels[index] >> (channel * 8)) & 0xFF) / 255.0f;
+
+                sum += (value - expected) * (value - expected);
+            }
+        }
+
+        return static_cast<float>(std::sqrt(sum / (image.pixels.size() * 3)));
+    }
+
+    // Accumulates each variant of the settings up to the requested samples against a reference with 4x as many,
+    // rendered with Sobol and MIS from another seed, without the denoiser and without adaptive sampling, so it shares
+    // no samples with the runs being measured. Samples are counted per pixel on average, since adaptive sampling
+    // leaves converged tiles out of a pass. Time to target only counts rendering, so it compares strategies per unit
+    // of time.
+    static void ReportConvergence(const Scene& scene, const Camera& camera, const Options& options) {
+        constexpr uint32_t ReferenceMultiplier = 4;
+
+        struct Variant {
+            const char* name;
+            Renderer::Settings settings;
+        };
+
+        std::vector<Variant> variants;
+
+        if (options.compare == "lighting") {
+            const char* names[] = { "BRDF", "Light", "MIS" };
+
+            for (Renderer::LightSampling lightSampling : { Renderer::LightSampling::BRDF, Renderer::LightSampling::Light, Renderer::LightSampling::MultipleImportance }) {
+                variants.push_back({ names[static_cast<int>(lightSampling)], options.settings });
+                variants.back().settings.lightSampling = lightSampling;
+            }
+        } else if (options.compare == "denoiser") {
+            variants.push_back({ "Raw", options.settings });
+            variants.back().settings.denoise = false;
+
+            variants.push_back({ "Denoised", options.settings });
+            variants.back().settings.denoise = true;
+        } else if (options.compare == "adaptive") {
+            variants.push_back({ "Uniform", options.settings });
+            variants.back().settings.adaptiveSampling = false;
+
+            variants.push_back({ "Adaptive", options.settings });
+            variants.back().settings.adaptiveSampling = true;
+        } else {
+            const char* names[] = { "Random", "Sobol", "Blue Noise" };
+
+            for (Sampler::Type sampler : { Sampler::Type::Random, Sampler::Type::Sobol, Sampler::Type::BlueNoise }) {
+                variants.push_back({ names[static_cast<int>(sampler)], options.settings });
+                variants.back().settings.sampler = sampler;
+            }
+        }
+
+        Renderer renderer;
+        renderer.lightDirection = options.lightDirection;
+        renderer.GetSettings() = options.settings;
+        renderer.GetSettings().accumulate = true;
+        renderer.OnResize(options.width, options.height);
+
+        renderer.GetSettings().sampler = Sampler::Type::Sobol;
+        renderer.GetSettings().lightSampling = Renderer::LightSampling::MultipleImportance;
+        renderer.GetSettings().seed = options.settings.seed + 1;
+        renderer.GetSettings().denoise = false;
+        renderer.GetSettings().adaptiveSampling = false;
+        renderer.ResetFrameIndex();
+
+        printf("Rendering the reference with %u samples\n", options.samples * ReferenceMultiplier);
+
+        for (uint32_t sample = 0; sample < options.samples * ReferenceMultiplier; sample += 1) {
+            renderer.Render(scene, camera);
+        }
+
+        Framebuffer reference = renderer.GetFinalImage();
+
+        printf("%-12s %20s %20s %20s\n", "Variant", "Samples to target", "Time to target", "Error at last");
+
+        for (const Variant& variant : variants) {
+            renderer.GetSettings() = variant.settings;
+            renderer.GetSettings().accumulate = true;
+            renderer.ResetFrameIndex();
+
+            float pixelCount = static_cast<float>(options.width) * static_cast<float>(options.height);
+            uint64_t pixelSamples = 0;
+
+            float samplesToTarget = 0.0f;
+            float renderTime = 0.0f;
+            float timeToTarget = 0.0f;
+            float error = 0.0f;
+
+            for (uint32_t sample = 1; sample <= options.samples; sample += 1) {
+                Timer timer;
+                renderer.Render(scene, camera);
+                renderTime += timer.ElapsedMillis();
+
+                pixelSamples += renderer.GetStatistics().samples;
+                error = RMSError(renderer.GetFinalImage(), reference);
+
+                if (samplesToTarget == 0.0f && error <= options.convergenceTarget) {
+                    samplesToTarget = static_cast<float>(pixelSamples) / pixelCount;
+                    timeToTarget = renderTime;
+                }
+            }
+
+            char samples[32];
+            char time[32];
+
+            if (samplesToTarget == 0.0f) {
+                snprintf(samples, sizeof(samples), "> %.4g", static_cast<float>(pixelSamples) / pixelCount);
+                snprintf(time, sizeof(time), "> %.0fms", renderTime);
+            } else {
+                snprintf(samples, sizeof(samples), "%.4g", samplesToTarget);
+                snprintf(time, sizeof(time), "%.0fms", timeToTarget);
+            }
+
+            printf("%-12s %20s %20s %20.5f\n", variant.name, samples, time, error);
+        }
+    }
+
+    // Accumulates the requested samples, then pans the camera sideways by MotionStride per step with one pass each,
+    // the way the application renders while the camera moves. Each variant is measured against a reference at the
+    // final position, rendered like the --convergence one.
+    static void ReportMotion(const Scene& scene, const Options& options) {
+        constexpr uint32_t ReferenceMultiplier = 4;
+        constexpr float MotionStride = 0.05f;
+
+        glm::vec3 right = glm::cross(options.direction, glm::vec3(0.0f, 1.0f, 0.0f));
+        right = glm::length(right) > 0.0f ? glm::normalize(right) : glm::vec3(1.0f, 0.0f, 0.0f);
+
+        Camera camera(45.0f, 0.1f, 100.0f);
+        camera.OnResize(options.width, options.height);
+
+        auto placeCamera = [&](uint32_t step) {
+            camera.SetView(options.position + right * (MotionStride * static_cast<float>(step)), options.direction);
+        };
+
+        struct Variant {
+            const char* name;
+            Renderer::Settings settings;
+        };
+
+        std::vector<Variant> variants;
+
+        variants.push_back({ "Reset", options.settings });
+        variants.back().settings.reprojection = false;
+        variants.back().settings.dynamicResolution = false;
+
+        variants.push_back({ "Reproject", options.settings });
+        variants.back().settings.reprojection = true;
+        variants.back().settings.dynamicResolution = false;
+
+        variants.push_back({ "Dynamic", options.settings });
+        variants.back().settings.reprojection = true;
+        variants.back().settings.dynamicResolution = true;
+
+        placeCamera(options.motionSteps);
+
+        Renderer referenceRenderer;
+        referenceRenderer.lightDirection = options.lightDirection;
+        referenceRenderer.GetSettings() = options.settings;
+        referenceRenderer.GetSettings().accumulate = true;
+        referenceRenderer.GetSettings().sampler = Sampler::Type::Sobol;
+        referenceRenderer.GetSettings().lightSampling = Renderer::LightSampling::MultipleImportance;
+        referenceRenderer.GetSettings().seed = options.settings.seed + 1;
+        referenceRenderer.GetSettings().denoise = false;
+        referenceRenderer.OnResize(options.width, options.height);
+
+        printf("Rendering the reference with %u samples\n", options.samples * ReferenceMultiplier);
+
+        for (uint32_t sample = 0; sample < options.samples * ReferenceMultiplier; sample += 1) {
+            referenceRenderer.Render(scene, camera);
+        }
+
+        Framebuffer reference = referenceRenderer.GetFinalImage();
+
+        printf("%-12s %20s %20s %20s\n", "Variant", "Time per move", "Render scale", "Error at last");
+
+        for (const Variant& variant : variants) {
+            Renderer renderer;
+            renderer.lightDirection = options.lightDirection;
+            renderer.GetSettings() = variant.settings;
+            renderer.GetSettings().accumulate = true;
+            renderer.OnResize(options.width, options.height);
+
+            placeCamera(0);
+
+            for (uint32_t sample = 0; sample < options.samples; sample += 1) {
+                renderer.Render(scene, camera);
+            }
+
+            float moveTime = 0.0f;
+            float renderScale = 0.0f;
+
+            for (uint32_t step = 1; step <= options.motionSteps; step += 1) {
+                placeCamera(step);
+                renderer.OnCameraMoved();
+
+                Timer timer;
+                renderer.Render(scene, camera);
+                moveTime += timer.ElapsedMillis();
+
+                renderScale += static_cast<float>(renderer.GetStatistics().renderScale);
+            }
+
+            float steps = static_cast<float>(options.motionSteps);
+
+            char time[32];
+            snprintf(time, sizeof(time), "%.1fms", moveTime / steps);
+
+            printf("%-12s %20s %20.2f %20.5f\n", variant.name, time, renderScale / steps, RMSError(renderer.GetFinalImage(), reference));
+        }
+    }
+
+    // Casts rays the way shadow rays leave a surface: from a random point on a random sphere, offset along the normal
+    // as the renderer does, into the hemisphere around it. Half of them are unbounded like the directional light's,
+    // and half end at a random distance like a sampled sphere light's. For each acceleration structure, the any-hit
+    // query must report an occluder exactly when the closest hit is nearer than the end of the ray. The structures
+    // are built the way the renderer builds them.
+    static bool ReportOcclusion(const Scene& scene, const Options& options) {
+        constexpr uint32_t RayCount = 20000;
+
+        BVH bvh;
+        bvh.Build(scene.spheres, options.settings.builder);
+
+        WideBVH wideBVH;
+        wideBVH.Build(bvh);
+
+        SphereSoA sphereSoA;
+        sphereSoA.Build(scene.spheres, bvh.GetPrimitiveIndices());
+
+        const BVH::Node& root = bvh.GetNodes().front();
+        float diagonal = glm::length(root.boundsMax - root.boundsMin);
+
+        RandomSequence random;
+        std::vector<Ray> rays(RayCount);
+        std::vector<float> maxDistances(RayCount);
+
+        for (uint32_t index = 0; index < RayCount; index += 1) {
+            float z = random.Float() * 2.0f - 1.0f;
+            float phi = 2.0f * Pi * random.Float();
+            float radius = std::sqrt(glm::max(1.0f - z * z, 0.0f));
+            glm::vec3 normal(radius * std::cos(phi), radius * std::sin(phi), z);
+
+            z = random.Float() * 2.0f - 1.0f;
+            phi = 2.0f * Pi * random.Float();
+            radius = std::sqrt(glm::max(1.0f - z * z, 0.0f));
+            glm::vec3 direction(radius * std::cos(phi), radius * std::sin(phi), z);
+
+            const Sphere& sphere = scene.spheres[random.UInt() % scene.spheres.size()];
+
+            rays[index].origin = sphere.position + normal * glm::abs(sphere.radius) + normal * 0.0001f;
+            rays[index].direction = glm::dot(direction, normal) < 0.0f ? -direction : direction;
+
+            maxDistances[index] = (index % 2 == 0) ? std::numeric_limits<float>::infinity() : random.Float() * diagonal;
+        }
+
+        printf("Casting %u rays against %zu spheres\n", RayCount, scene.spheres.size());
+        printf("%-12s %20s %20s %20s %20s\n", "Structure", "Occluded", "Mismatches", "Closest hit nodes", "Any hit nodes");
+
+        const char* names[] = { "None", "BVH", "Wide BVH" };
+        bool valid = true;
+
+        for (Renderer::Acceleration acceleration : { Renderer::Acceleration::None, Renderer::Acceleration::BVH, Renderer::Acceleration::WideBVH }) {
+            uint64_t closestNodes = 0;
+            uint64_t anyNodes = 0;
+            uint32_t occludedCount = 0;
+            uint32_t mismatches = 0;
+
+            for (uint32_t index = 0; index < RayCount; index += 1) {
+                const Ray& ray = rays[index];
+                float maxDistance = maxDistances[index];
+
+                float hitDistance = std::numeric_limits<float>::max();
+                int objectIndex = -1;
+                uint32_t nodesVisited = 0;
+                bool occluded = false;
+
+                switch (acceleration) {
+                    case Renderer::Acceleration::None:
+                        sphereSoA.Intersect(ray, 0, sphereSoA.GetCount(), hitDistance, objectIndex);
+                        occluded = sphereSoA.Occluded(ray, 0, sphereSoA.GetCount(), maxDistance);
+                        break;
+                    case Renderer::Acceleration::BVH:
+                        bvh.Intersect(ray, sphereSoA, hitDistance, objectIndex, nodesVisited);
+                        closestNodes += nodesVisited;
+                        nodesVisited = 0;
+                        occluded = bvh.Occluded(ray, sphereSoA, maxDistance, nodesVisited);
+                        anyNodes += nodesVisited;
+                        break;
+                    case Renderer::Acceleration::WideBVH:
+                        wideBVH.Intersect(ray, sphereSoA, hitDistance, objectIndex, nodesVisited);
+                        closestNodes += nodesVisited;
+                        nodesVisited = 0;
+                        occluded = wideBVH.Occluded(ray, sphereSoA, maxDistance, nodesVisited);
+                        anyNodes += nodesVisited;
+                        break;
+                }
+
+                bool expected = objectIndex >= 0 && hitDistance < maxDistance;
+
+                occludedCount += occluded ? 1 : 0;
+                mismatches += occluded != expected ? 1 : 0;
+            }
+
+            printf("%-12s %20u %20u %20.1f %20.1f\n", names[static_cast<int>(acceleration)], occludedCount, mismatches,
+                   static_cast<float>(closestNodes) / RayCount, static_cast<float>(anyNodes) / RayCount);
+
+            valid = valid && mismatches == 0;
+        }
+
+        return valid;
+    }
+
+    // Two estimates of each quantity, one from the BRDF's sampling and one from integrating what it evaluates over a
+    // stratified grid of the hemisphere, for metals and dielectrics over a range of roughness and view angles:
+    // - The mean sample weight against the integral of f * cos, the fraction of light the surface reflects
+    // - The fraction of samples above the surface against the integral of the density, which only match when the
+    //   density Evaluate reports is the one SampleDirection samples with
+    static float Luminance(const glm::vec3& color) {
+        return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+    }
+
+    static bool ReportBRDF() {
+        constexpr uint32_t GridSize = 1024;
+        constexpr uint32_t SampleCount = GridSize * GridSize;
+        constexpr float Tolerance = 0.005f;
+
+        glm::vec3 normal(0.0f, 0.0f, 1.0f);
+
+        printf("%-10s %-10s %-10s %14s %14s %14s %14s\n", "Metallic", "Roughness", "View cos", "Integrated", "Sampled", "Density", "Accepted");
+
+        float worstError = 0.0f;
+
+        for (float metallic : { 0.0f, 1.0f }) {
+            for (float roughness : { 0.3f, 0.5f, 0.75f, 1.0f }) {
+                for (float viewCosine : { 0.9f, 0.5f, 0.2f }) {
+                    Material material;
+                    material.albedo = { 0.8f, 0.6f, 0.4f };
+                    material.roughness = roughness;
+                    material.metallic = metallic;
+
+                    glm::vec3 view(std::sqrt(1.0f - viewCosine * viewCosine), 0.0f, viewCosine);
+
+                    // Uniform over the hemisphere, one direction at the middle of each cell of the (cos, phi) grid. A
+                    // million terms are summed, so in double precision.
+                    glm::dvec3 integratedSum(0.0);
+                    double densitySum = 0.0;
+
+                    for (uint32_t row = 0; row < GridSize; row += 1) {
+                        for (uint32_t column = 0; column < GridSize; column += 1) {
+                            float cosine = (static_cast<float>(row) + 0.5f) / GridSize;
+                            float phi = 2.0f * Pi * (static_cast<float>(column) + 0.5f) / GridSize;
+                            float sine = std::sqrt(glm::max(1.0f - cosine * cosine, 0.0f));
+
+                            glm::vec3 light(sine * std::cos(phi), sine * std::sin(phi), cosine);
+
+                            float pdf;
+                            integratedSum += glm::dvec3(BRDF::Evaluate(material, normal, view, light, pdf));
+                            densitySum += pdf;
+                        }
+                    }
+
+                    glm::vec3 integrated = glm::vec3(integratedSum * (2.0 * Pi / SampleCount));
+                    float density = static_cast<float>(densitySum * (2.0 * Pi / SampleCount));
+
+                    // The lobe choice is left random, and the direction within it is stratified the same way
+                    RandomSequence random;
+                    glm::dvec3 sampledSum(0.0);
+                    uint32_t accepted = 0;
+
+                    for (uint32_t row = 0; row < GridSize; row += 1) {
+                        for (uint32_t column = 0; column < GridSize; column += 1) {
+                            glm::vec3 u(random.Float(), (static_cast<float>(row) + 0.5f) / GridSize, (static_cast<float>(column) + 0.5f) / GridSize);
+
+                            BRDF::Sample sample;
+
+                            if (BRDF::SampleDirection(material, normal, view, u, sample)) {
+                                sampledSum += glm::dvec3(sample.weight);
+                                accepted += 1;
+                            }
+                        }
+                    }
+
+                    glm::vec3 sampled = glm::vec3(sampledSum / static_cast<double>(SampleCount));
+                    float acceptedFraction = static_cast<float>(accepted) / SampleCount;
+
+                    for (int channel = 0; channel < 3; channel += 1) {
+                        worstError = glm::max(worstError, glm::abs(sampled[channel] - integrated[channel]) / integrated[channel]);
+                    }
+
+                    worstError = glm::max(worstError, glm::abs(acceptedFraction - density) / density);
+
+                    printf("%-10.2f %-10.2f %-10.2f %14.5f %14.5f %14.5f %14.5f\n", metallic, roughness, viewCosine,
+                           Luminance(integrated), Luminance(sampled), density, acceptedFraction);
+                }
+            }
+        }
+
+        printf("Largest relative difference: %.3f%%\n", worstError * 100.0f);
+
+        return worstError <= Tolerance;
+    }
+}
+
+int main(int argc, char** argv) {
+    Utils::Options options;
+
+    if (!Utils::ParseOptions(argc, argv, options)) {
+        Utils::PrintUsage(argv[0]);
+        return 1;
+    }
+
+    Scene scene;
+
+    if (options.scenePath.empty()) {
+        Utils::CreateDefaultScene(scene);
+    } else if (!Utils::LoadScene(options.scenePath, scene)) {
+        return 1;
+    }
+
+    if (!options.environmentPath.empty() && !Utils::LoadEnvironment(options.environmentPath, scene)) {
+        return 1;
+    }
+
+    Utils::GenerateSpheres(scene, options.randomSpheres, options.emissiveSpheres);
+
+    Camera camera(45.0f, 0.1f, 100.0f);
+    camera.OnResize(options.width, options.height);
+    camera.SetView(options.position, options.direction);
+
+    if (options.convergenceTarget > 0.0f) {
+        Utils::ReportConvergence(scene, camera, options);
+        return 0;
+    }
+
+    if (options.motionSteps > 0) {
+        Utils::ReportMotion(scene, options);
+        return 0;
+    }
+
+    if (options.validate == "occlusion") {
+        return Utils::ReportOcclusion(scene, options) ? 0 : 1;
+    }
+
+    if (options.validate == "brdf") {
+        return Utils::ReportBRDF() ? 0 : 1;
+    }
+
+    Renderer renderer;
+    renderer.lightDirection = options.lightDirection;
+    renderer.GetSettings() = options.settings;
+    renderer.GetSettings().accumulate = true;
+    renderer.OnResize(options.width, options.height);
+
+    printf("Rendering %zu spheres at %ux%u, %u samples per pixel\n", scene.spheres.size(), options.width, options.height, options.samples);
+
+    Timer timer;
+    uint64_t raysTraced = 0;
+    uint64_t pixelSamples = 0;
+
+    for (uint32_t sample = 0; sample < options.samples; sample += 1) {
+        renderer.Render(scene, camera);
+        raysTraced += renderer.GetStatistics().raysTraced;
+        pixelSamples += renderer.GetStatistics().samples;
+
+        printf("\rSample %u/%u", sample + 1, options.samples);
+        fflush(stdout);
+
+        if (renderer.GetStatistics().convergedFraction == 1.0f) {
+            printf(", converged");
+            break;
+        }
+    }
+
+    float seconds = timer.Elapsed();
+    double samplesPerPixel = static_cast<double>(pixelSamples) / (static_cast<double>(options.width) * options.height);
+
+    printf("\nRendered in %.3fs: %.2f samples per pixel, %.2f Msamples/s, %.2f Mrays/s\n", seconds, samplesPerPixel, pixelSamples / seconds / 1.0e6, raysTraced / seconds / 1.0e6);
+
+    if (!Utils::WriteImage(options.outputPath, renderer.GetFinalImage())) {
+        fprintf(stderr, "Could not write %s\n", options.outputPath.c_str());
+        return 1;
+    }
+
+    printf("Wrote %s\n", options.outputPath.c_str());
+
+    return 0;
+}